@@ -0,0 +1,268 @@
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "async-log.h"
+#include "timing.h"
+
+// Compares the time spent at the call site by the logging in code/vlog.cpp,
+// which formats the message into a std::string and writes it straight away,
+// with the asynchronous logger in async-log.h.
+//
+// Usage: async-log [threads [messages per thread [file]]]
+//
+// Each thread logs the messages from vlog.cpp in turn, timing every call. The
+// output goes to /dev/null unless a file is given. The total time includes
+// waiting for the asynchronous logger to write everything.
+//
+// First it checks that a message that has to wrap round to the start of a
+// ring, and needs more than half of it, gets through, and that flush()
+// returns while other threads are logging.
+
+using namespace std;
+using namespace fmt;
+
+using clock_type = chrono::steady_clock;
+
+int fd;
+
+// The vlog.cpp version, writing with write() under a lock so lines from
+// different threads don't get mixed up.
+mutex write_mutex;
+
+void vlog_error(int code, std::string_view fmt, format_args args)
+{
+    string s = format("Error {}: {}\n", code, vformat(fmt, args));
+    lock_guard<mutex> lock(write_mutex);
+    if (::write(fd, s.data(), s.size()) < 0)
+    {
+        abort();
+    }
+}
+
+template<class... Args>
+void log_error(int code, std::string_view fmt, const Args&... args)
+{
+    vlog_error(code, fmt, make_format_args(args...));
+}
+
+logging::Logger* logger;
+
+struct SyncLog
+{
+    static constexpr const char* name = "vlog";
+
+    void operator()(int i) const
+    {
+        switch (i % 3)
+        {
+        case 0: log_error(1, "Bad input detected: {} is not an integer value", 10.1); break;
+        case 1: log_error(10, "Oops - Type mismatch between {} and {}", "var1", i); break;
+        default: log_error(255, "Something went wrong!"); break;
+        }
+    }
+};
+
+struct AsyncLog
+{
+    static constexpr const char* name = "async";
+
+    void operator()(int i) const
+    {
+        switch (i % 3)
+        {
+        case 0: logger->log("Error {}: Bad input detected: {} is not an integer value", 1, 10.1); break;
+        case 1: logger->log("Error {}: Oops - Type mismatch between {} and {}", 10, "var1", i); break;
+        default: logger->log("Error {}: Something went wrong!", 255); break;
+        }
+    }
+};
+
+// Times just reading the clock, to show how much of each call's time is the
+// measurement itself.
+struct ClockOnly
+{
+    static constexpr const char* name = "clock";
+
+    void operator()(int i) const
+    {
+        perf::do_not_optimize(i);
+    }
+};
+
+template<class Log>
+void run(int threads, int messages)
+{
+    vector<vector<int64_t>> latencies(threads, vector<int64_t>(messages));
+    auto begin = clock_type::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&latencies, t, messages] {
+            Log log;
+            auto& lat = latencies[t];
+            for (int i = 0; i < messages; ++i)
+            {
+                auto start = clock_type::now();
+                log(i);
+                lat[i] = chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - start).count();
+            }
+        });
+    }
+    for (auto& w: workers)
+    {
+        w.join();
+    }
+    if (logger)
+    {
+        logger->flush();
+    }
+    chrono::duration<double> elapsed = clock_type::now() - begin;
+
+    vector<int64_t> all;
+    for (const auto& lat: latencies)
+    {
+        all.insert(all.end(), lat.begin(), lat.end());
+    }
+    sort(all.begin(), all.end());
+    print("{:<8} {:>7} {:>8} {:>8} {:>8} {:>8} {:>10} {:>12.0f}\n", Log::name, threads,
+          perf::percentile(all, 0.5), perf::percentile(all, 0.9), perf::percentile(all, 0.99),
+          perf::percentile(all, 0.999), all.back(), all.size() / elapsed.count());
+}
+
+// Log a message of 2000 characters and then one of 3000 to a ring of 4096
+// bytes, so the second has to wrap round, and check both are written. Gives
+// up after 10 seconds rather than waiting for ever.
+bool check_wrap()
+{
+    char path[] = "/tmp/async-log-XXXXXX";
+    int test_fd = mkstemp(path);
+    if (test_fd < 0)
+    {
+        return false;
+    }
+    unlink(path);
+    string first(2000, 'a');
+    string second(3000, 'b');
+    alarm(10);
+    {
+        logging::Logger log(test_fd, 4096);
+        log.log("{}", first);
+        log.flush();
+        log.log("{}", second);
+        log.flush();
+    }
+    alarm(0);
+    string expected = first + "\n" + second + "\n";
+    string written(expected.size() + 1, '\0');
+    auto n = pread(test_fd, written.data(), written.size(), 0);
+    close(test_fd);
+    return n == static_cast<ssize_t>(expected.size()) && written.compare(0, n, expected) == 0;
+}
+
+// Call flush() while two other threads keep logging, and check it returns
+// and that the message logged before it is written. The output goes to a
+// pipe that is read slowly, so the logger is held up in write() while the
+// others fill their rings, and always finds more to do. Gives up after 10
+// seconds, as check_wrap() does.
+bool check_flush_while_logging()
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+    {
+        return false;
+    }
+    string written;
+    thread reader([&] {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(pipe_fds[0], buf, sizeof(buf))) > 0)
+        {
+            written.append(buf, n);
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    });
+    alarm(10);
+    {
+        logging::Logger log(pipe_fds[1]);
+        atomic<bool> done{false};
+        vector<thread> others;
+        for (int t = 0; t < 2; ++t)
+        {
+            others.emplace_back([&log, &done, t] {
+                while (!done.load())
+                {
+                    log.log("Thread {} is still logging", t);
+                }
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds(20));
+        log.log("{}", "flushed");
+        log.flush();
+        done.store(true);
+        for (auto& t: others)
+        {
+            t.join();
+        }
+    }
+    alarm(0);
+    close(pipe_fds[1]);
+    reader.join();
+    close(pipe_fds[0]);
+    return written.find("\nflushed\n") != written.npos;
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int messages = argc > 2 ? atoi(argv[2]) : 200'000;
+    const char* file = argc > 3 ? argv[3] : "/dev/null";
+    if (threads < 1 || messages < 1)
+    {
+        cerr << "Usage: async-log [threads [messages per thread [file]]]\n";
+        return 1;
+    }
+    if (!check_wrap())
+    {
+        cerr << "A message wrapping round the end of a ring wasn't written\n";
+        return 1;
+    }
+    if (!check_flush_while_logging())
+    {
+        cerr << "A message logged before flush() wasn't written while other threads were logging\n";
+        return 1;
+    }
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        cerr << "Can't open " << file << "\n";
+        return 1;
+    }
+
+    print("Call site latency in ns\n");
+    print("{:<8} {:>7} {:>8} {:>8} {:>8} {:>8} {:>10} {:>12}\n", "method", "threads", "p50", "p90",
+          "p99", "p99.9", "max", "messages/s");
+    run<ClockOnly>(threads, messages);
+    run<SyncLog>(threads, messages);
+    {
+        logging::Logger log(fd);
+        logger = &log;
+        run<AsyncLog>(threads, messages);
+        if (log.waits() || log.dropped() || log.write_errors())
+        {
+            print("async: {} waits for a full ring, {} dropped, {} write errors\n",
+                  log.waits(), log.dropped(), log.write_errors());
+        }
+        logger = nullptr;
+    }
+    close(fd);
+}
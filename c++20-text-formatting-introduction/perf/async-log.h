@@ -0,0 +1,474 @@
+// An asynchronous logger using the same split as code/vlog.cpp: a template
+// front end that knows the argument types, and a back end that doesn't.
+//
+// Instead of formatting at the call site, log() copies the format string
+// pointer and the arguments into a ring buffer belonging to the calling
+// thread. Each ring has a single producer (its thread) and a single consumer
+// (the logger's background thread), so no locks are needed to use it. The
+// background thread formats every waiting message into one reused
+// memory_buffer and writes it to the file descriptor with a single write()
+// once it has enough, or has run out of messages.
+//
+// Nothing is allocated per message. A thread allocates its ring the first
+// time it logs.
+//
+// Arguments can be arithmetic types, enums, pointers and strings (char
+// pointers, std::string and std::string_view), whose characters are copied.
+// The format string itself is not copied, so it must be a string literal or
+// otherwise outlive the logger. As with fmt::format, the format string is
+// checked against the argument types at compile time.
+//
+// If a thread's ring is full, log() waits for the background thread to make
+// room. A message too big to fit in an empty ring is dropped.
+
+#ifndef PERF_ASYNC_LOG_H
+#define PERF_ASYNC_LOG_H
+
+#include <fmt/format.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+
+namespace logging
+{
+
+namespace detail
+{
+
+// The type an argument is stored as. Arrays, such as string literals, decay
+// to pointers, and char pointers are treated as strings.
+template<class T>
+using arg_t = std::conditional_t<std::is_same_v<std::decay_t<T>, char*>, const char*, std::decay_t<T>>;
+
+template<class T>
+constexpr bool is_string_v = std::is_same_v<T, const char*> || std::is_same_v<T, std::string>
+    || std::is_same_v<T, std::string_view>;
+
+// How an argument of type T is copied into a ring and read back out.
+template<class T, class = void>
+struct Codec
+{
+    static_assert(sizeof(T) == 0, "logging: argument type can't be copied into the log buffer");
+};
+
+template<class T>
+struct Codec<T, std::enable_if_t<std::is_scalar_v<T> && !is_string_v<T>>>
+{
+    static std::size_t size(const T&)
+    {
+        return sizeof(T);
+    }
+
+    static char* write(char* p, const T& value)
+    {
+        std::memcpy(p, &value, sizeof(T));
+        return p + sizeof(T);
+    }
+
+    static T read(const char*& p)
+    {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+};
+
+// Strings are stored as their length followed by their characters, and read
+// back as a string_view into the ring.
+template<class T>
+struct Codec<T, std::enable_if_t<is_string_v<T>>>
+{
+    static std::string_view view(const T& value)
+    {
+        return std::string_view(value);
+    }
+
+    static std::size_t size(const T& value)
+    {
+        return sizeof(std::size_t) + view(value).size();
+    }
+
+    static char* write(char* p, const T& value)
+    {
+        auto s = view(value);
+        auto n = s.size();
+        std::memcpy(p, &n, sizeof(n));
+        std::memcpy(p + sizeof(n), s.data(), n);
+        return p + sizeof(n) + n;
+    }
+
+    static std::string_view read(const char*& p)
+    {
+        std::size_t n;
+        std::memcpy(&n, p, sizeof(n));
+        std::string_view s(p + sizeof(n), n);
+        p += sizeof(n) + n;
+        return s;
+    }
+};
+
+using FormatFn = void (*)(fmt::string_view, const char*, fmt::memory_buffer&);
+
+// The start of every record in a ring. A record with skip set just fills the
+// space at the end of the ring that was too small for the next record.
+struct Header
+{
+    std::uint32_t size;
+    std::uint32_t skip;
+    FormatFn format;
+    const char* fmt;
+    std::size_t fmt_size;
+};
+
+constexpr std::size_t record_align = alignof(Header);
+
+constexpr std::size_t round_up(std::size_t n)
+{
+    return (n + record_align - 1) & ~(record_align - 1);
+}
+
+// Read the arguments back out of a record and format them. The braced
+// initialiser makes sure they are read in order.
+template<class... Args>
+void format_record(fmt::string_view f, const char* p, fmt::memory_buffer& out)
+{
+    std::tuple<decltype(Codec<Args>::read(p))...> values{Codec<Args>::read(p)...};
+    std::apply([&](const auto&... v) {
+        fmt::vformat_to(std::back_inserter(out), f, fmt::make_format_args(v...));
+    }, values);
+}
+
+// A single producer, single consumer ring of records. The capacity must be a
+// power of two, and a multiple of record_align.
+class Ring
+{
+public:
+    explicit Ring(std::size_t capacity)
+    : capacity_(capacity), data_(new char[capacity])
+    {
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    // Producer: find n contiguous bytes, or return null if there isn't room.
+    char* reserve(std::size_t n)
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        auto tail = tail_.load(std::memory_order_acquire);
+        auto offset = head & (capacity_ - 1);
+        auto to_end = capacity_ - offset;
+        if (n > to_end)
+        {
+            // Fill the end of the ring with a record to skip, and publish it
+            // straight away. Waiting for room for it and the record together
+            // could wait for ever, as they can need more than the ring holds.
+            if (head + to_end - tail > capacity_)
+            {
+                return nullptr;
+            }
+            auto h = reinterpret_cast<Header*>(data_.get() + offset);
+            h->size = static_cast<std::uint32_t>(to_end);
+            h->skip = 1;
+            head += to_end;
+            head_.store(head, std::memory_order_release);
+            offset = 0;
+        }
+        if (head + n - tail > capacity_)
+        {
+            return nullptr;
+        }
+        reserved_ = head;
+        return data_.get() + offset;
+    }
+
+    // Producer: make the n bytes from the last reserve() visible.
+    void commit(std::size_t n)
+    {
+        head_.store(reserved_ + n, std::memory_order_release);
+    }
+
+    // Consumer: call f with each record, and return how many there were.
+    template<class F>
+    std::size_t consume(F f)
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto head = head_.load(std::memory_order_acquire);
+        std::size_t count = 0;
+        while (tail != head)
+        {
+            auto h = reinterpret_cast<const Header*>(data_.get() + (tail & (capacity_ - 1)));
+            if (!h->skip)
+            {
+                f(*h);
+                ++count;
+            }
+            tail += h->size;
+            tail_.store(tail, std::memory_order_release);
+        }
+        return count;
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::size_t capacity_;
+    std::unique_ptr<char[]> data_;
+    std::size_t reserved_ = 0;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+struct ThreadBuffer
+{
+    explicit ThreadBuffer(std::size_t capacity)
+    : ring(capacity)
+    {
+    }
+
+    Ring ring;
+    std::atomic<bool> closed{false};
+};
+
+// The rings a thread has for each logger it has used. They are shared with
+// the loggers, so either side can go first, and are marked closed when the
+// thread exits so the logger can throw them away once it has emptied them.
+struct ThreadBuffers
+{
+    struct Slot
+    {
+        std::uint64_t logger_id = 0;
+        std::shared_ptr<ThreadBuffer> buffer;
+    };
+
+    ~ThreadBuffers()
+    {
+        for (auto& s: slots)
+        {
+            if (s.buffer)
+            {
+                s.buffer->closed.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    Slot slots[4];
+    std::size_t next = 0;
+};
+
+inline thread_local ThreadBuffers thread_buffers;
+
+inline std::atomic<std::uint64_t> next_logger_id{1};
+
+} // namespace detail
+
+class Logger
+{
+public:
+    // Messages are written to fd, which the logger doesn't close. Each thread
+    // gets a ring of ring_bytes, a power of two, and the output is written
+    // whenever write_bytes of it is waiting.
+    explicit Logger(int fd, std::size_t ring_bytes = 1 << 20, std::size_t write_bytes = 64 * 1024)
+    : fd_(fd), ring_bytes_(ring_bytes), write_bytes_(write_bytes),
+      id_(detail::next_logger_id++), thread_([this] { run(); })
+    {
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Writes everything logged so far before returning.
+    ~Logger()
+    {
+        stop_.store(true);
+        thread_.join();
+    }
+
+    template<class... Args>
+    void log(fmt::format_string<Args...> f, const Args&... args)
+    {
+        std::size_t size = sizeof(detail::Header);
+        ((size += detail::Codec<detail::arg_t<Args>>::size(args)), ...);
+        size = detail::round_up(size);
+
+        auto& ring = buffer().ring;
+        if (size > ring.capacity())
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        char* p;
+        while (!(p = ring.reserve(size)))
+        {
+            waits_.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+
+        fmt::string_view s = f;
+        auto h = reinterpret_cast<detail::Header*>(p);
+        h->size = static_cast<std::uint32_t>(size);
+        h->skip = 0;
+        h->format = &detail::format_record<detail::arg_t<Args>...>;
+        h->fmt = s.data();
+        h->fmt_size = s.size();
+        p += sizeof(detail::Header);
+        ((p = detail::Codec<detail::arg_t<Args>>::write(p, args)), ...);
+        ring.commit(size);
+    }
+
+    // Wait until everything logged before the call has been written.
+    void flush()
+    {
+        auto ticket = flush_requested_.fetch_add(1) + 1;
+        while (flush_done_.load() < ticket)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    // How many times a call found its ring full and had to wait.
+    std::uint64_t waits() const { return waits_.load(); }
+    // How many messages were too big for a ring.
+    std::uint64_t dropped() const { return dropped_.load(); }
+    // How many write() calls failed.
+    std::uint64_t write_errors() const { return write_errors_.load(); }
+
+private:
+    detail::ThreadBuffer& buffer()
+    {
+        auto& tb = detail::thread_buffers;
+        for (auto& s: tb.slots)
+        {
+            if (s.logger_id == id_)
+            {
+                return *s.buffer;
+            }
+        }
+        auto& slot = tb.slots[tb.next++ % std::size(tb.slots)];
+        if (slot.buffer)
+        {
+            slot.buffer->closed.store(true, std::memory_order_release);
+        }
+        slot.logger_id = id_;
+        slot.buffer = std::make_shared<detail::ThreadBuffer>(ring_bytes_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(slot.buffer);
+        return *slot.buffer;
+    }
+
+    // Format everything waiting in the rings, and return whether there was
+    // anything.
+    bool drain()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool any = false;
+        for (auto it = buffers_.begin(); it != buffers_.end();)
+        {
+            auto& b = **it;
+            bool closed = b.closed.load(std::memory_order_acquire);
+            any |= b.ring.consume([this](const detail::Header& h) {
+                h.format({h.fmt, h.fmt_size}, reinterpret_cast<const char*>(&h + 1), out_);
+                out_.push_back('\n');
+                if (out_.size() >= write_bytes_)
+                {
+                    write_out();
+                }
+            }) != 0;
+            if (closed && b.ring.empty())
+            {
+                it = buffers_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        return any;
+    }
+
+    void write_out()
+    {
+        std::size_t done = 0;
+        while (done < out_.size())
+        {
+            auto n = ::write(fd_, out_.data() + done, out_.size() - done);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                write_errors_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        out_.clear();
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            bool stopping = stop_.load();
+            auto ticket = flush_requested_.load();
+            bool any = drain();
+            if (out_.size() != 0)
+            {
+                write_out();
+            }
+            // Everything committed before the ticket was read has now been
+            // written, whether or not other threads have logged since.
+            flush_done_.store(ticket);
+            if (!any)
+            {
+                if (stopping)
+                {
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    }
+
+    const int fd_;
+    const std::size_t ring_bytes_;
+    const std::size_t write_bytes_;
+    const std::uint64_t id_;
+
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<detail::ThreadBuffer>> buffers_;
+    fmt::memory_buffer out_;
+
+    std::atomic<bool> stop_{false};
+    std::atomic<std::uint64_t> flush_requested_{0};
+    std::atomic<std::uint64_t> flush_done_{0};
+    std::atomic<std::uint64_t> waits_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> write_errors_{0};
+
+    std::thread thread_;
+};
+
+} // namespace logging
+
+#endif // PERF_ASYNC_LOG_H
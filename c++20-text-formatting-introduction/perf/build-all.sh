@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Builds the benchmark programs into prgs/. Unlike the examples in code/ they
+# aren't run, as their output changes every time - run them by hand.
+
+cd $(dirname $0)
+
+if [ ! -d prgs ]
+then
+    mkdir prgs
+fi
+
+function buildit
+{
+    NAME=$1
+    cppfile=${NAME}.cpp
+    prgfile=prgs/${NAME}
+    if [ ! -f $prgfile ]
+    then
+        prgtime="0"
+    else
+        prgtime=$(stat -c "%Y" $prgfile)
+    fi
+    newest=$(stat -c "%Y" $cppfile *.h | sort -n | tail -1)
+    if [ $newest -gt $prgtime ]
+    then
+        echo "Building $NAME"
+        g++ --std=c++20 -O2 $cppfile -lfmt -lpthread -o $prgfile || exit 1
+    else
+        echo "$NAME up-to-date"
+    fi
+}
+
+buildit async-log
+buildit checked-log
+buildit fd-sink
+buildit fixed-width
+buildit float-format
+buildit format-exact
+buildit int-format
+buildit locale-cache
+buildit printf-vs-format
+buildit range-format
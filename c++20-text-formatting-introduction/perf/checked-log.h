@@ -0,0 +1,73 @@
+// A version of log_error from code/vlog.cpp whose format strings are parsed
+// at compile time.
+//
+// LOG_ERROR(code, "format", args...) passes the format string through
+// FMT_COMPILE, which turns it into a type holding the parsed pieces of the
+// string: the literal text, and which argument goes where with which format
+// spec. Formatting with it just runs through those pieces, without looking
+// at the string again. Parsing at compile time also means a missing argument
+// or a spec that doesn't suit its argument's type is a compile error rather
+// than a format_error at run time, e.g.
+//
+//     LOG_ERROR(1, "Oops - Type mismatch between {} and {}", "var1");
+//     LOG_ERROR(2, "Using format: {:s}", 10);
+//
+// both fail to compile. Unused arguments are allowed, as they are by format().
+//
+// The message is formatted into a buffer on the stack, only allocating if it
+// is longer than inline_size, and handed to the non-template vlog_error.
+
+#ifndef PERF_CHECKED_LOG_H
+#define PERF_CHECKED_LOG_H
+
+#include <fmt/compile.h>
+#include <fmt/format.h>
+#include <iostream>
+#include <iterator>
+
+namespace checked_log
+{
+
+constexpr std::size_t inline_size = 256;
+
+using Buffer = fmt::basic_memory_buffer<char, inline_size>;
+
+inline void vlog_error(fmt::string_view message)
+{
+    std::cout.write(message.data(), message.size());
+}
+
+// A format string made by FMT_COMPILE, as the macros below pass it. The
+// functions take only this, so a plain string doesn't compile.
+template<class S>
+struct Compiled
+{
+    S f;
+};
+
+// Format the whole line, "Error code: message\n", into buf.
+template<class S, class... Args>
+void format_error(Buffer& buf, int code, Compiled<S> c, const Args&... args)
+{
+    auto out = fmt::format_to(std::back_inserter(buf), FMT_COMPILE("Error {}: "), code);
+    out = fmt::format_to(out, c.f, args...);
+    *out++ = '\n';
+}
+
+template<class S, class... Args>
+void log_error(int code, Compiled<S> c, const Args&... args)
+{
+    Buffer buf;
+    format_error(buf, code, c, args...);
+    vlog_error({buf.data(), buf.size()});
+}
+
+} // namespace checked_log
+
+#define LOG_ERROR(code, f, ...) \
+    ::checked_log::log_error(code, ::checked_log::Compiled{FMT_COMPILE(f)} __VA_OPT__(,) __VA_ARGS__)
+
+#define FORMAT_ERROR(buf, code, f, ...) \
+    ::checked_log::format_error(buf, code, ::checked_log::Compiled{FMT_COMPILE(f)} __VA_OPT__(,) __VA_ARGS__)
+
+#endif // PERF_CHECKED_LOG_H
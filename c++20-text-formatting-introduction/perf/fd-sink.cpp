@@ -0,0 +1,124 @@
+#include <fmt/format.h>
+#include <fmt/os.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include "fd-sink.h"
+
+// Writes a report of a few million lines to a file in several ways and
+// compares the time taken:
+//
+//   ofstream << format  - the cout << format(...) of the examples in code/,
+//                         with an ofstream in place of cout
+//   fmt::output_file    - fmt's own buffered file, from fmt/os.h
+//   FdSink              - format_to into a 1MB buffer written with write()
+//   FdSink O_DIRECT     - the same with the file opened with O_DIRECT
+//   MmapSink            - format_to straight into a mapped file
+//
+// Usage: fd-sink [file [lines]]
+//
+// The file is /tmp/fd-sink.out unless given. Each method is run three times
+// and the best time kept, and the files are checked to be the same.
+
+using namespace std;
+using namespace fmt;
+
+using clock_type = chrono::steady_clock;
+
+const char* names[] = {"widgets", "sprockets", "gaskets", "flanges", "grommets", "washers"};
+
+double amount(size_t i) { return static_cast<double>(i * 2654435761u % 10'000'000) / 100; }
+size_t quantity(size_t i) { return i * 40503u % 1000; }
+
+#define REPORT_LINE "{:>8} {:<12} {:>12.2f} {:>6}\n", i, names[i % 6], amount(i), quantity(i)
+
+void with_ofstream(const char* path, size_t lines)
+{
+    ofstream out(path);
+    for (size_t i = 0; i < lines; ++i)
+    {
+        out << format(REPORT_LINE);
+    }
+}
+
+void with_output_file(const char* path, size_t lines)
+{
+    auto out = output_file(path);
+    for (size_t i = 0; i < lines; ++i)
+    {
+        out.print(REPORT_LINE);
+    }
+}
+
+bool direct_used = false;
+
+void with_fd_sink(const char* path, size_t lines, bool direct)
+{
+    sink::FdSink out(path, direct);
+    direct_used = out.direct();
+    for (size_t i = 0; i < lines; ++i)
+    {
+        format_to(out.out(), REPORT_LINE);
+    }
+    out.close();
+}
+
+void with_mmap_sink(const char* path, size_t lines)
+{
+    sink::MmapSink out(path);
+    for (size_t i = 0; i < lines; ++i)
+    {
+        format_to(out.out(), REPORT_LINE);
+    }
+    out.close();
+}
+
+string contents(const char* path)
+{
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), {});
+}
+
+template<class F>
+void run(std::string_view method, const char* path, size_t lines, const string& expected, F f)
+{
+    double best = 1e300;
+    for (int i = 0; i < 3; ++i)
+    {
+        auto begin = clock_type::now();
+        f();
+        chrono::duration<double, std::milli> elapsed = clock_type::now() - begin;
+        best = min(best, elapsed.count());
+    }
+    if (!expected.empty() && contents(path) != expected)
+    {
+        cerr << method << " wrote a different file\n";
+        exit(1);
+    }
+    double mb = expected.empty() ? static_cast<double>(contents(path).size()) / 1e6 : expected.size() / 1e6;
+    print("{:<18} {:>10.1f} {:>10.1f} {:>10.2f}\n", method, best, mb / best * 1e3, lines / best / 1e3);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = argc > 1 ? argv[1] : "/tmp/fd-sink.out";
+    size_t lines = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2'000'000;
+
+    print("{:<18} {:>10} {:>10} {:>10}\n", "method", "ms", "MB/s", "Mlines/s");
+    run("ofstream << format", path, lines, {}, [&] { with_ofstream(path, lines); });
+    auto expected = contents(path);
+    run("fmt::output_file", path, lines, expected, [&] { with_output_file(path, lines); });
+    run("FdSink", path, lines, expected, [&] { with_fd_sink(path, lines, false); });
+    run("FdSink O_DIRECT", path, lines, expected, [&] { with_fd_sink(path, lines, true); });
+    if (!direct_used)
+    {
+        print("  (O_DIRECT isn't supported for {}, so that was an ordinary FdSink)\n", path);
+    }
+    run("MmapSink", path, lines, expected, [&] { with_mmap_sink(path, lines); });
+
+    std::remove(path);
+}
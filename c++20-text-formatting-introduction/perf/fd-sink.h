@@ -0,0 +1,335 @@
+// Output sinks that fmt formats straight into, for writing large reports.
+//
+// The examples in code/ do cout << format(...), which builds a std::string,
+// copies it into the stream's buffer, and locks the stream for the copy.
+// These sinks are fmt buffers, like fmt::ostream in fmt/os.h, so format_to
+// writes the text once, into memory the sink owns, and nothing is locked.
+// Each sink belongs to one thread.
+//
+//   FdSink    - a large page-aligned buffer written to a file descriptor when
+//               it fills. Long strings passed to write() go out with writev()
+//               together with the buffer rather than being copied. A file
+//               can be opened with O_DIRECT, to bypass the page cache.
+//   MmapSink  - formats straight into a file mapped into memory, which is
+//               extended as it fills, and cut to the right length at the end
+//
+//     sink::FdSink out("report.txt");
+//     fmt::format_to(out.out(), "{:>8} {:<12}\n", id, name);
+//     out.print("{} records\n", count);
+//     out.close();
+//
+// Errors throw std::system_error, as fmt::ostream does. The destructors
+// finish the output but can't report errors, so call close() to see them.
+
+#ifndef PERF_FD_SINK_H
+#define PERF_FD_SINK_H
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace sink
+{
+
+namespace detail
+{
+
+// Write all of iov, carrying on after partial writes and interruptions.
+inline void write_all(int fd, iovec* iov, int count)
+{
+    while (count != 0)
+    {
+        ssize_t n = ::writev(fd, iov, count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw fmt::system_error(errno, "cannot write to file");
+        }
+        auto left = static_cast<std::size_t>(n);
+        while (count != 0 && left >= iov->iov_len)
+        {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count != 0)
+        {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
+inline int open_for_writing(const char* path, int flags)
+{
+    return ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | flags, 0644);
+}
+
+// The sinks are fmt::detail::buffer<char>s, as fmt::ostream is, since that is
+// the only way to have fmt format into memory they own. That class isn't part
+// of fmt's API and changes between versions (grow(), which the sinks
+// override, isn't virtual from fmt 11), so only fmt 9, which this was
+// written against, is accepted.
+static_assert(FMT_VERSION >= 90000 && FMT_VERSION < 100000, "fd-sink.h uses fmt 9's detail::buffer");
+
+} // namespace detail
+
+class FdSink final : private fmt::detail::buffer<char>
+{
+public:
+    // O_DIRECT needs the buffer, and every write, to be a whole number of
+    // blocks of this size.
+    static constexpr std::size_t block_size = 4096;
+    static constexpr std::size_t default_capacity = std::size_t{1} << 20;
+
+    // Write to fd, which is left open.
+    explicit FdSink(int fd, std::size_t capacity = default_capacity)
+    {
+        init(fd, false, capacity);
+    }
+
+    // Create or truncate the file at path and write to it. With direct, try
+    // to open it with O_DIRECT; not every file system allows it, in which
+    // case the file is opened normally and direct() is false.
+    explicit FdSink(const char* path, bool direct = false, std::size_t capacity = default_capacity)
+    {
+        int fd = direct ? detail::open_for_writing(path, O_DIRECT) : -1;
+        direct = fd >= 0;
+        if (!direct)
+        {
+            fd = detail::open_for_writing(path, 0);
+        }
+        if (fd < 0)
+        {
+            throw fmt::system_error(errno, "cannot open {}", path);
+        }
+        init(fd, true, capacity);
+        direct_ = direct;
+    }
+
+    FdSink(const FdSink&) = delete;
+    FdSink& operator=(const FdSink&) = delete;
+
+    ~FdSink()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+        std::free(data());
+    }
+
+    fmt::appender out() { return fmt::appender(*this); }
+
+    template<class... Args>
+    void print(fmt::format_string<Args...> f, Args&&... args)
+    {
+        fmt::vformat_to(out(), f, fmt::make_format_args(args...));
+    }
+
+    // Append s. A string too long for the space left is written together
+    // with the buffer by one writev() instead of being copied into it.
+    void write(std::string_view s)
+    {
+        if (s.size() <= capacity() - size() || direct_)
+        {
+            append(s.data(), s.data() + s.size());
+            return;
+        }
+        iovec iov[2] = {{data(), size()}, {const_cast<char*>(s.data()), s.size()}};
+        detail::write_all(fd_, iov, 2);
+        clear();
+    }
+
+    // Write out what has been formatted so far. With O_DIRECT only whole
+    // blocks can be written, so up to a block is kept back until close().
+    void flush()
+    {
+        std::size_t n = direct_ ? size() / block_size * block_size : size();
+        if (n == 0)
+        {
+            return;
+        }
+        iovec iov = {data(), n};
+        detail::write_all(fd_, &iov, 1);
+        std::memmove(data(), data() + n, size() - n);
+        try_resize(size() - n);
+    }
+
+    // Write everything out, and close the file if the sink opened it.
+    void close()
+    {
+        if (fd_ < 0)
+        {
+            return;
+        }
+        flush();
+        if (direct_ && size() != 0)
+        {
+            // The last part block is written with O_DIRECT turned off.
+            ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) & ~O_DIRECT);
+            direct_ = false;
+            flush();
+        }
+        int fd = std::exchange(fd_, -1);
+        if (owned_ && ::close(fd) != 0)
+        {
+            throw fmt::system_error(errno, "cannot close file");
+        }
+    }
+
+    bool direct() const { return direct_; }
+
+private:
+    void init(int fd, bool owned, std::size_t capacity)
+    {
+        capacity = (std::max(capacity, block_size) + block_size - 1) / block_size * block_size;
+        auto p = static_cast<char*>(std::aligned_alloc(block_size, capacity));
+        if (!p)
+        {
+            if (owned)
+            {
+                ::close(fd);
+            }
+            throw std::bad_alloc();
+        }
+        set(p, capacity);
+        fd_ = fd;
+        owned_ = owned;
+    }
+
+    // Called when the buffer is full.
+    void grow(std::size_t) override
+    {
+        if (size() == capacity())
+        {
+            flush();
+        }
+    }
+
+    int fd_ = -1;
+    bool owned_ = false;
+    bool direct_ = false;
+};
+
+class MmapSink final : private fmt::detail::buffer<char>
+{
+public:
+    static constexpr std::size_t default_chunk = std::size_t{64} << 20;
+
+    // Create or truncate the file at path, and map the first chunk bytes of
+    // it. The file and the mapping grow by at least chunk bytes at a time.
+    explicit MmapSink(const char* path, std::size_t chunk = default_chunk)
+    : chunk_(chunk)
+    {
+        fd_ = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+        {
+            throw fmt::system_error(errno, "cannot open {}", path);
+        }
+        try
+        {
+            remap(chunk_);
+        }
+        catch (...)
+        {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    MmapSink(const MmapSink&) = delete;
+    MmapSink& operator=(const MmapSink&) = delete;
+
+    ~MmapSink()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    fmt::appender out() { return fmt::appender(*this); }
+
+    template<class... Args>
+    void print(fmt::format_string<Args...> f, Args&&... args)
+    {
+        fmt::vformat_to(out(), f, fmt::make_format_args(args...));
+    }
+
+    void write(std::string_view s)
+    {
+        append(s.data(), s.data() + s.size());
+    }
+
+    // Unmap the file, cut it to the length written, and close it.
+    void close()
+    {
+        if (fd_ < 0)
+        {
+            return;
+        }
+        ::munmap(data(), capacity());
+        std::size_t used = size();
+        clear();
+        set(nullptr, 0);
+        int fd = std::exchange(fd_, -1);
+        if (::ftruncate(fd, static_cast<off_t>(used)) != 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw fmt::system_error(error, "cannot set file size");
+        }
+        if (::close(fd) != 0)
+        {
+            throw fmt::system_error(errno, "cannot close file");
+        }
+    }
+
+private:
+    void remap(std::size_t length)
+    {
+        if (::ftruncate(fd_, static_cast<off_t>(length)) != 0)
+        {
+            throw fmt::system_error(errno, "cannot extend file");
+        }
+        void* p = data() ? ::mremap(data(), capacity(), length, MREMAP_MAYMOVE)
+                         : ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED)
+        {
+            throw fmt::system_error(errno, "cannot map file");
+        }
+        set(static_cast<char*>(p), length);
+    }
+
+    void grow(std::size_t wanted) override
+    {
+        remap((std::max(wanted, capacity() + chunk_) + chunk_ - 1) / chunk_ * chunk_);
+    }
+
+    int fd_ = -1;
+    std::size_t chunk_;
+};
+
+} // namespace sink
+
+#endif // PERF_FD_SINK_H
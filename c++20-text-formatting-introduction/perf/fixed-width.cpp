@@ -0,0 +1,202 @@
+#include <fmt/format.h>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fixed-width.h"
+#include "timing.h"
+
+// Writes a report of a million fixed-width records to /dev/null, or the file
+// given as the argument, through a 1MB buffer:
+//
+//   format      - fmt::format_to of the whole line into a memory_buffer, with
+//                 widths in the format string, so long values widen the line
+//   format_to_n - format_to_n of each field into its place, as in
+//                 code/format_to_n.cpp, padding by hand and ignoring the size
+//   Writer      - fixedwidth::Writer from fixed-width.h
+//   memcpy      - copying the Writer's output, for the memory bandwidth
+//
+// It first shows a few records with values too wide for their columns.
+
+using namespace std;
+using namespace fmt;
+
+struct Row
+{
+    int id;
+    string name;
+    double amount;
+    int quantity;
+};
+
+const fixedwidth::Layout layout({
+    {8, fixedwidth::Align::right},
+    {12},
+    {10, fixedwidth::Align::right, ' ', fixedwidth::Overflow::mark},
+    {6, fixedwidth::Align::right},
+}, " | ");
+
+constexpr size_t buffer_size = 1 << 20;
+
+int fd;
+
+void flush(std::string_view s)
+{
+    if (::write(fd, s.data(), s.size()) < 0)
+    {
+        cerr << "write failed\n";
+        exit(1);
+    }
+}
+
+size_t with_writer(const vector<Row>& rows, char* buf)
+{
+    fixedwidth::Writer w(layout, buf, buffer_size);
+    size_t total = 0;
+    for (const auto& r: rows)
+    {
+        if (!w.begin_record())
+        {
+            flush(w.contents());
+            total += w.contents().size();
+            w.clear();
+            w.begin_record();
+        }
+        w.field(r.id);
+        w.field(r.name);
+        w.field("{:.2f}", r.amount);
+        w.field(r.quantity);
+        w.end_record();
+    }
+    flush(w.contents());
+    return total + w.contents().size();
+}
+
+size_t with_format(const vector<Row>& rows)
+{
+    memory_buffer buf;
+    size_t total = 0;
+    for (const auto& r: rows)
+    {
+        format_to(back_inserter(buf), "{:>8} | {:<12} | {:>10.2f} | {:>6}\n", r.id, r.name, r.amount, r.quantity);
+        if (buf.size() >= buffer_size - 64)
+        {
+            flush({buf.data(), buf.size()});
+            total += buf.size();
+            buf.clear();
+        }
+    }
+    flush({buf.data(), buf.size()});
+    return total + buf.size();
+}
+
+// One field with format_to_n, padded on the right or left by hand.
+template<class... Args>
+char* put(char* p, size_t width, bool right, format_string<Args...> f, Args&&... args)
+{
+    auto res = format_to_n(p, width, f, args...);
+    auto n = min(res.size, width);
+    if (right)
+    {
+        memmove(p + width - n, p, n);
+        memset(p, ' ', width - n);
+    }
+    else
+    {
+        memset(p + n, ' ', width - n);
+    }
+    return p + width;
+}
+
+size_t with_format_to_n(const vector<Row>& rows, char* buf)
+{
+    auto record = layout.record_size();
+    size_t used = 0, total = 0;
+    for (const auto& r: rows)
+    {
+        if (buffer_size - used < record)
+        {
+            flush({buf, used});
+            total += used;
+            used = 0;
+        }
+        char* p = buf + used;
+        p = put(p, 8, true, "{}", r.id);
+        p = copy_n(" | ", 3, p);
+        p = put(p, 12, false, "{}", r.name);
+        p = copy_n(" | ", 3, p);
+        p = put(p, 10, true, "{:.2f}", r.amount);
+        p = copy_n(" | ", 3, p);
+        p = put(p, 6, true, "{}", r.quantity);
+        *p = '\n';
+        used += record;
+    }
+    flush({buf, used});
+    return total + used;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* file = argc > 1 ? argv[1] : "/dev/null";
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        cerr << "Can't open " << file << "\n";
+        return 1;
+    }
+
+    vector<Row> samples{
+        {1, "widget", 12.5, 3},
+        {123456789, "an extremely long name", 1e12, 1234567},
+        {42, "gadget", -0.125, 0},
+    };
+    char small[1024];
+    fixedwidth::Writer sw(layout, small, sizeof(small));
+    for (const auto& r: samples)
+    {
+        sw.begin_record();
+        sw.field(r.id);
+        sw.field(r.name);
+        sw.field("{:.2f}", r.amount);
+        sw.field(r.quantity);
+        auto t = sw.end_record();
+        string cols;
+        for (size_t i = 0; i < layout.size(); ++i)
+        {
+            if (t.column(i))
+            {
+                cols += format(" {}", i);
+            }
+        }
+        cout << std::string_view(sw.contents()).substr(sw.contents().size() - layout.record_size(), layout.record_size() - 1);
+        cout << (t ? format("   truncated columns:{}", cols) : string()) << "\n";
+    }
+    cout << "\n";
+
+    vector<Row> rows;
+    const char* names[] = {"widget", "gadget", "sprocket", "flange", "grommet", "a long product name"};
+    for (int i = 0; i < 1'000'000; ++i)
+    {
+        rows.push_back({i, names[i % 6], (i % 100'000) * 1.37, i % 1000});
+    }
+    auto buf = make_unique<char[]>(buffer_size);
+
+    print("{:<12} {:>10} {:>10}\n", "method", "ms/report", "MB/s");
+    auto show = [](std::string_view method, perf::Timing t) {
+        print("{:<12} {:>10.2f} {:>10.1f}\n", method, t.ns_per_call / 1e6, t.mb_per_sec());
+    };
+    show("format", perf::time_calls([&] { return with_format(rows); }));
+    show("format_to_n", perf::time_calls([&] { return with_format_to_n(rows, buf.get()); }));
+    show("Writer", perf::time_calls([&] { return with_writer(rows, buf.get()); }));
+    auto dst = make_unique<char[]>(buffer_size);
+    show("memcpy", perf::time_calls([&] {
+        memcpy(dst.get(), buf.get(), buffer_size);
+        perf::do_not_optimize(dst[0]);
+        return buffer_size;
+    }));
+    close(fd);
+}
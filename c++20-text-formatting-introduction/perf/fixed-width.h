@@ -0,0 +1,242 @@
+// Writing fixed-width records, like the tables in code/widths.cpp and
+// code/align-fill.cpp, into a char array supplied by the caller.
+//
+// A width in a format spec is only a minimum, so a value that is too wide
+// pushes the rest of the line along, as the 10000000 in widths.out does. In
+// code/format_to_n.cpp format_to_n cuts each value down instead, but the size
+// it returns is thrown away, so nobody knows what was lost.
+//
+// Here a Layout gives the width, alignment, fill character and overflow
+// handling of each column, and a Writer formats each field with format_to_n
+// straight into its place in the buffer. Every record is exactly
+// Layout::record_size() characters. A field that doesn't fit is either cut
+// off at the column width or filled with '#', and is reported in the result
+// of end_record() and in a count for its column.
+//
+//     fixedwidth::Layout layout({{8}, {12}, {10, fixedwidth::Align::right}});
+//     char buf[1 << 16];
+//     fixedwidth::Writer w(layout, buf, sizeof(buf));
+//     if (!w.begin_record())
+//     {
+//         // write w.contents() somewhere, then w.clear()
+//     }
+//     w.field(id);
+//     w.field(name);
+//     w.field("{:.2f}", amount);
+//     auto truncated = w.end_record();
+//
+// Nothing is allocated once the Layout and Writer have been made.
+
+#ifndef PERF_FIXED_WIDTH_H
+#define PERF_FIXED_WIDTH_H
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace fixedwidth
+{
+
+enum class Align { left, right, centre };
+
+enum class Overflow
+{
+    cut,    // keep as much of the start as fits
+    mark,   // fill the field with '#'
+};
+
+struct Column
+{
+    std::size_t width;
+    Align align = Align::left;
+    char fill = ' ';
+    Overflow overflow = Overflow::cut;
+};
+
+class Layout
+{
+public:
+    Layout(std::initializer_list<Column> columns, std::string_view sep = " ", std::string_view end = "\n")
+    : columns_(columns), sep_(sep), end_(end)
+    {
+        assert(!columns_.empty());
+        record_size_ = end_.size() + sep_.size() * (columns_.size() - 1);
+        for (const auto& c: columns_)
+        {
+            record_size_ += c.width;
+        }
+    }
+
+    std::size_t record_size() const { return record_size_; }
+    std::size_t size() const { return columns_.size(); }
+    const Column& operator[](std::size_t i) const { return columns_[i]; }
+    std::string_view sep() const { return sep_; }
+    std::string_view end() const { return end_; }
+
+private:
+    std::vector<Column> columns_;
+    std::string sep_;
+    std::string end_;
+    std::size_t record_size_;
+};
+
+// Which fields of a record didn't fit. Only the first 64 columns are
+// recorded in the mask, but all of them are counted.
+struct Truncated
+{
+    std::uint64_t mask = 0;
+    std::size_t count = 0;
+
+    explicit operator bool() const { return count != 0; }
+    bool column(std::size_t i) const { return i < 64 && (mask >> i) & 1; }
+};
+
+class Writer
+{
+public:
+    Writer(const Layout& layout, char* data, std::size_t capacity)
+    : layout_(layout), data_(data), capacity_(capacity), column_counts_(layout.size())
+    {
+    }
+
+    // Start a record, or return false if there isn't room for a whole one.
+    bool begin_record()
+    {
+        if (capacity_ - used_ < layout_.record_size())
+        {
+            return false;
+        }
+        next_ = data_ + used_;
+        column_ = 0;
+        truncated_ = {};
+        return true;
+    }
+
+    // Write the next field.
+    template<class... Args>
+    void field(fmt::format_string<Args...> f, Args&&... args)
+    {
+        assert(column_ < layout_.size());
+        const auto& col = layout_[column_];
+        if (column_ != 0)
+        {
+            next_ = copy(layout_.sep(), next_);
+        }
+        auto result = fmt::format_to_n(next_, col.width, f, args...);
+        place(col, result.size);
+        next_ += col.width;
+        ++column_;
+    }
+
+    // Write the next field with the default format. Integers and strings
+    // are copied in directly rather than going through format_to_n.
+    template<class T>
+    void field(const T& value)
+    {
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>)
+        {
+            fmt::format_int s(value);
+            text({s.data(), s.size()});
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            text(std::string_view(value));
+        }
+        else
+        {
+            field("{}", value);
+        }
+    }
+
+    // Finish the record, and return which of its fields were truncated.
+    Truncated end_record()
+    {
+        assert(column_ == layout_.size());
+        next_ = copy(layout_.end(), next_);
+        used_ += layout_.record_size();
+        return truncated_;
+    }
+
+    std::string_view contents() const { return {data_, used_}; }
+    std::size_t records() const { return used_ / layout_.record_size(); }
+    void clear() { used_ = 0; }
+
+    // How many fields in the given column have been truncated.
+    std::size_t truncated(std::size_t column) const { return column_counts_[column]; }
+
+private:
+    void text(std::string_view s)
+    {
+        assert(column_ < layout_.size());
+        const auto& col = layout_[column_];
+        if (column_ != 0)
+        {
+            next_ = copy(layout_.sep(), next_);
+        }
+        std::memcpy(next_, s.data(), std::min(s.size(), col.width));
+        place(col, s.size());
+        next_ += col.width;
+        ++column_;
+    }
+
+    static char* copy(std::string_view s, char* out)
+    {
+        std::memcpy(out, s.data(), s.size());
+        return out + s.size();
+    }
+
+    // Move the n characters just formatted at next_ into position, and fill
+    // the rest of the field.
+    void place(const Column& col, std::size_t n)
+    {
+        if (n > col.width)
+        {
+            if (column_ < 64)
+            {
+                truncated_.mask |= std::uint64_t{1} << column_;
+            }
+            ++truncated_.count;
+            ++column_counts_[column_];
+            if (col.overflow == Overflow::mark)
+            {
+                std::memset(next_, '#', col.width);
+            }
+            return;
+        }
+        auto pad = col.width - n;
+        std::size_t before = 0;
+        switch (col.align)
+        {
+        case Align::left: before = 0; break;
+        case Align::right: before = pad; break;
+        case Align::centre: before = pad / 2; break;
+        }
+        if (before != 0)
+        {
+            std::memmove(next_ + before, next_, n);
+            std::memset(next_, col.fill, before);
+        }
+        std::memset(next_ + before + n, col.fill, pad - before);
+    }
+
+    const Layout& layout_;
+    char* data_;
+    std::size_t capacity_;
+    std::size_t used_ = 0;
+    char* next_ = nullptr;
+    std::size_t column_ = 0;
+    Truncated truncated_;
+    std::vector<std::size_t> column_counts_;
+};
+
+} // namespace fixedwidth
+
+#endif // PERF_FIXED_WIDTH_H
@@ -0,0 +1,97 @@
+#include <fmt/format.h>
+#include <bit>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include "float-format.h"
+#include "timing.h"
+
+// Formats a million doubles with each spec below, each followed by a space,
+// with fmt::format_to one value at a time and with floatfmt::format_all, and
+// checks they give the same text. The data sets are:
+//
+//   prices  - amounts in cents divided by 100, as read from a file
+//   wide    - random bit patterns, so any exponent, with some infinities,
+//             nans and negative zeros mixed in
+//   ticks   - values of a few thousand with several decimal places
+
+using namespace std;
+using namespace fmt;
+
+const char* specs[] = {"", "+", ".2f", "f", "F", ".0f", ".9f", "e", ".3g", "10.2f", "#"};
+
+bool ok = true;
+
+void run(std::string_view name, const vector<double>& values)
+{
+    vector<char> out;
+    for (const char* s: specs)
+    {
+        floatfmt::Formatter formatter(s);
+        string f = std::string("{:") + s + "} ";
+        memory_buffer expected;
+        for (auto v: values)
+        {
+            format_to(back_inserter(expected), runtime(f), v);
+        }
+        out.resize(values.size() * floatfmt::max_size(formatter, " "));
+        auto end = floatfmt::format_all(values, formatter, " ", out.data());
+        std::string_view name_spec = *s ? s : "{}";
+        if (std::string_view(out.data(), end - out.data()) != std::string_view(expected.data(), expected.size()))
+        {
+            cerr << "floatfmt gives different text for " << name << " {:" << s << "}\n";
+            ok = false;
+            continue;
+        }
+
+        auto report = [&](std::string_view method, const perf::Timing& t) {
+            print("{:<8} {:<8} {:<16} {:>10.2f} {:>10.1f} {:>10.1f}\n", name, name_spec, method,
+                  t.ns_per_call / 1e6, values.size() / t.ns_per_call * 1e3, t.mb_per_sec());
+        };
+        report("fmt::format_to", perf::time_calls([&] {
+            memory_buffer buf;
+            for (auto v: values)
+            {
+                format_to(back_inserter(buf), runtime(f), v);
+            }
+            return buf.size();
+        }));
+        report("floatfmt", perf::time_calls([&] {
+            return static_cast<size_t>(floatfmt::format_all(values, formatter, " ", out.data()) - out.data());
+        }));
+    }
+}
+
+int main()
+{
+    constexpr size_t count = 1'000'000;
+    mt19937_64 rng(42);
+    vector<double> prices, wide, ticks;
+    for (size_t i = 0; i < count; ++i)
+    {
+        prices.push_back(static_cast<double>(rng() % 10'000'000) / 100);
+        ticks.push_back(1000 + static_cast<double>(rng() % 100'000'000) / 1e5 * 3.7);
+
+        double w = bit_cast<double>(rng());
+        switch (rng() % 50)
+        {
+        case 0: w = numeric_limits<double>::infinity(); break;
+        case 1: w = -numeric_limits<double>::infinity(); break;
+        case 2: w = numeric_limits<double>::quiet_NaN(); break;
+        case 3: w = -numeric_limits<double>::quiet_NaN(); break;
+        case 4: w = -0.0; break;
+        }
+        wide.push_back(w);
+    }
+
+    print("{:<8} {:<8} {:<16} {:>10} {:>10} {:>10}\n", "data", "spec", "method", "ms/call", "Mval/s", "MB/s");
+    run("prices", prices);
+    run("ticks", ticks);
+    run("wide", wide);
+
+    return ok ? 0 : 1;
+}
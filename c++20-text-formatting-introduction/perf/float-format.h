@@ -0,0 +1,358 @@
+// Formatting arrays of doubles with one spec, for dumping millions of them.
+//
+// A floatfmt::Formatter is made once from a spec, the part after the ':' in
+// "{:.2f}", and formats each value into a char array. format_all() formats a
+// whole span with it, putting a separator after each value. The output is
+// the same as fmt::format gives, including the inf and nan forms shown in
+// output/float-inf-nan.out, but the commonest specs take shorter paths:
+//
+//   {}, {:+} and {: }    - the shortest digits that read back as the same
+//                          value, found with std::to_chars and laid out
+//                          directly, fixed or exponential as fmt chooses
+//   {:.Nf} and {:f}      - the value times 10^N rounded to an integer, when
+//                          that is exact enough to give the correctly rounded
+//                          digits, and the point put in
+//
+// Values these paths can't handle, and all other specs, such as a width, '#',
+// e, g or a, go through fmt's own formatter<double>, parsed once when the
+// Formatter is made.
+
+#ifndef PERF_FLOAT_FORMAT_H
+#define PERF_FLOAT_FORMAT_H
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace floatfmt
+{
+
+class Formatter
+{
+public:
+    static constexpr int max_precision = 10'000;
+    static constexpr unsigned max_width = 100'000;
+
+    // Throws fmt::format_error if spec isn't valid for a double, or has a
+    // precision over max_precision or a width over max_width, which would
+    // make max_size() too big to be useful.
+    explicit Formatter(std::string_view spec)
+    {
+        if (spec.find('{') != spec.npos)
+        {
+            throw fmt::format_error("dynamic width and precision aren't supported");
+        }
+        fmt::format_parse_context ctx(spec);
+        auto end = general_.parse(ctx);
+        if (end != spec.end() && *end != '}')
+        {
+            throw fmt::format_error("unknown format specifier");
+        }
+        classify(spec);
+    }
+
+    // Format v at out, which must have room for max_size() characters, and
+    // return the end of the output.
+    char* format(double v, char* out) const
+    {
+        if (mode_ != Mode::general)
+        {
+            if (!std::isfinite(v))
+            {
+                return special(v, out);
+            }
+            if (mode_ == Mode::shortest)
+            {
+                return shortest(v, out);
+            }
+            if (auto end = fixed(v, out))
+            {
+                return end;
+            }
+        }
+        fmt::basic_format_context<char*, char> ctx(out, {});
+        return general_.format(v, ctx);
+    }
+
+    // The most characters format() can write: the digits of the largest
+    // double in fixed notation, the precision and the width, and some spare.
+    std::size_t max_size() const { return max_size_; }
+
+private:
+    enum class Mode { shortest, fixed, general };
+
+    // Work out whether the spec is one of those with a short path: an
+    // optional sign, then nothing, or a precision and f or F, or just f or F.
+    void classify(std::string_view spec)
+    {
+        auto [width, precision] = width_and_precision(spec);
+        max_size_ = 330 + std::max(precision, 17) + width;
+
+        std::size_t i = 0;
+        if (i < spec.size() && (spec[i] == '+' || spec[i] == '-' || spec[i] == ' '))
+        {
+            sign_ = spec[i++];
+        }
+        bool has_precision = i < spec.size() && spec[i] == '.';
+        if (has_precision)
+        {
+            while (++i < spec.size() && spec[i] >= '0' && spec[i] <= '9')
+            {
+            }
+        }
+        char type = i < spec.size() ? spec[i++] : 0;
+        bool known = i == spec.size() || spec[i] == '}';
+
+        if (known && type == 0 && !has_precision)
+        {
+            mode_ = Mode::shortest;
+        }
+        else if (known && (type == 'f' || type == 'F'))
+        {
+            mode_ = Mode::fixed;
+            upper_ = type == 'F';
+            precision_ = has_precision ? precision : 6;
+        }
+    }
+
+    // The width and precision anywhere in the spec, or 0 and -1 if it has
+    // none. The width is the last run of digits before the precision; a
+    // digit used as the fill can make it look bigger, which only wastes
+    // space in max_size().
+    static std::pair<unsigned, int> width_and_precision(std::string_view spec)
+    {
+        auto dot = spec.find('.');
+        unsigned width = 0;
+        unsigned run = 0;
+        for (char c: spec.substr(0, dot))
+        {
+            if (c >= '0' && c <= '9')
+            {
+                run = run * 10 + (c - '0');
+                if (run > max_width)
+                {
+                    throw fmt::format_error("width is too big");
+                }
+                width = run;
+            }
+            else
+            {
+                run = 0;
+            }
+        }
+        int precision = -1;
+        if (dot != spec.npos)
+        {
+            precision = 0;
+            for (auto i = dot + 1; i < spec.size() && spec[i] >= '0' && spec[i] <= '9'; ++i)
+            {
+                precision = precision * 10 + (spec[i] - '0');
+                if (precision > max_precision)
+                {
+                    throw fmt::format_error("precision is too big");
+                }
+            }
+        }
+        return {width, precision};
+    }
+
+    char* sign(double v, char* out) const
+    {
+        if (std::signbit(v))
+        {
+            *out++ = '-';
+        }
+        else if (sign_ != '-')
+        {
+            *out++ = sign_;
+        }
+        return out;
+    }
+
+    char* special(double v, char* out) const
+    {
+        out = sign(v, out);
+        const char* name = std::isinf(v) ? (upper_ ? "INF" : "inf") : (upper_ ? "NAN" : "nan");
+        std::memcpy(out, name, 3);
+        return out + 3;
+    }
+
+    static char* copy(const char* s, std::size_t n, char* out)
+    {
+        std::memcpy(out, s, n);
+        return out + n;
+    }
+
+    // fmt writes the shortest digits in fixed notation when the first digit
+    // is at most 16 places before the point or 4 after it, and as d.ddde+XX
+    // otherwise.
+    char* shortest(double v, char* out) const
+    {
+        out = sign(v, out);
+        if (v == 0)
+        {
+            *out = '0';
+            return out + 1;
+        }
+        // to_chars gives the shortest digits as d.ddde+XX, from which the
+        // digits and the power of ten of the first are taken.
+        char sci[32];
+        auto end = std::to_chars(sci, sci + sizeof(sci), std::fabs(v), std::chars_format::scientific).ptr;
+        char d[17];
+        int n = 0;
+        const char* p = sci;
+        for (; *p != 'e'; ++p)
+        {
+            if (*p != '.')
+            {
+                d[n++] = *p;
+            }
+        }
+        bool negative = *++p == '-';
+        int first = 0;
+        while (++p != end)
+        {
+            first = first * 10 + (*p - '0');
+        }
+        first = negative ? -first : first;
+        int exp = first - n + 1;
+
+        if (first < -4 || first >= 16)
+        {
+            *out++ = d[0];
+            if (n > 1)
+            {
+                *out++ = '.';
+                out = copy(d + 1, n - 1, out);
+            }
+            *out++ = 'e';
+            *out++ = first < 0 ? '-' : '+';
+            unsigned e = std::abs(first);
+            if (e >= 100)
+            {
+                *out++ = static_cast<char>('0' + e / 100);
+                e %= 100;
+            }
+            *out++ = static_cast<char>('0' + e / 10);
+            *out++ = static_cast<char>('0' + e % 10);
+            return out;
+        }
+        if (exp >= 0)
+        {
+            out = copy(d, n, out);
+            std::memset(out, '0', exp);
+            return out + exp;
+        }
+        if (first >= 0)
+        {
+            out = copy(d, first + 1, out);
+            *out++ = '.';
+            return copy(d + first + 1, n - first - 1, out);
+        }
+        *out++ = '0';
+        *out++ = '.';
+        std::memset(out, '0', -first - 1);
+        return copy(d, n, out + (-first - 1));
+    }
+
+    // v * 10^precision as a correctly rounded integer, with the digits after
+    // the point put in. The product is computed with its rounding error, from
+    // fma, so the exact product is known to be above or below the half-way
+    // point between two integers unless it is very close. Returns nullptr,
+    // having written nothing, if the product is too big for a double to hold
+    // as an integer, or is too close to half-way to tell.
+    char* fixed(double v, char* out) const
+    {
+        if (precision_ > 15)
+        {
+            return nullptr;
+        }
+        double scale = pow10[precision_];
+        double a = std::fabs(v);
+        double p = a * scale;
+        if (!(p < 1e15))
+        {
+            return nullptr;
+        }
+        double r = std::nearbyint(p);
+        double err = std::fma(a, scale, -p);
+        if (err != 0)
+        {
+            // p rounds the exact product a * scale; nearbyint rounds p,
+            // halves to even. r is right unless the exact product is on the
+            // other side of half-way from p.
+            double t = (p - r) + err;
+            if (std::fabs(std::fabs(t) - 0.5) < 1e-9)
+            {
+                return nullptr;
+            }
+            r += t > 0.5 ? 1 : t < -0.5 ? -1 : 0;
+        }
+
+        out = sign(v, out);
+        fmt::format_int digits(static_cast<std::uint64_t>(r));
+        const char* d = digits.data();
+        int n = static_cast<int>(digits.size());
+        int whole = n - precision_;
+        if (whole <= 0)
+        {
+            *out++ = '0';
+            if (precision_ != 0)
+            {
+                *out++ = '.';
+                std::memset(out, '0', -whole);
+                out += -whole;
+                out = copy(d, n, out);
+            }
+            return out;
+        }
+        out = copy(d, whole, out);
+        if (precision_ != 0)
+        {
+            *out++ = '.';
+            out = copy(d + whole, precision_, out);
+        }
+        return out;
+    }
+
+    static constexpr double pow10[16] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                         1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+    fmt::formatter<double> general_;
+    Mode mode_ = Mode::general;
+    char sign_ = '-';
+    bool upper_ = false;
+    int precision_ = 0;
+    std::size_t max_size_ = 0;
+};
+
+// The most characters format_all() writes for each value.
+inline std::size_t max_size(const Formatter& f, std::string_view sep)
+{
+    return f.max_size() + sep.size();
+}
+
+// Format every value, each followed by sep, into out, which must have room
+// for values.size() * max_size(f, sep) characters. Returns the end of the
+// output.
+inline char* format_all(std::span<const double> values, const Formatter& f, std::string_view sep, char* out)
+{
+    for (auto v: values)
+    {
+        out = f.format(v, out);
+        std::memcpy(out, sep.data(), sep.size());
+        out += sep.size();
+    }
+    return out;
+}
+
+} // namespace floatfmt
+
+#endif // PERF_FLOAT_FORMAT_H
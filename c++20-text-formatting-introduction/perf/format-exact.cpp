@@ -0,0 +1,93 @@
+#include <fmt/format.h>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include "format-exact.h"
+#include "timing.h"
+
+// Counts the heap allocations made by each way of formatting a short, a
+// medium and a long message, and times them:
+//
+//   format         - fmt::format
+//   size+format    - formatted_size followed by format, as in
+//                    code/formatted_size.cpp
+//   size+format_to - formatted_size, then format_to into a string resized
+//                    to fit, so one exact allocation but two passes
+//   format_exact   - from format-exact.h
+//   format_small   - format_small<256>
+//   format_into    - into an arena on the stack
+//
+// The global operator new is replaced with one that counts calls, in the same
+// way as who-are-you-calling-weak/common.ipp but without printing.
+
+std::size_t allocations = 0;
+
+void* operator new(std::size_t sz)
+{
+    ++allocations;
+    if (auto p = std::malloc(sz ? sz : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using namespace std;
+using namespace fmt;
+
+template<class F>
+void run(std::string_view name, std::string_view method, F func)
+{
+    auto before = allocations;
+    func();
+    auto per_call = allocations - before;
+    auto t = perf::time_calls(func);
+    print("{:<10} {:<16} {:>10.1f} {:>10.1f} {:>12}\n", name, method, t.ns_per_call, t.mb_per_sec(), per_call);
+}
+
+template<class... Args>
+void run_all(std::string_view name, format_string<const Args&...> f, const Args&... args)
+{
+    run(name, "format", [&] { return format(f, args...).size(); });
+    run(name, "size+format", [&] {
+        perf::do_not_optimize(formatted_size(f, args...));
+        return format(f, args...).size();
+    });
+    run(name, "size+format_to", [&] {
+        string s(formatted_size(f, args...), '\0');
+        format_to(s.data(), f, args...);
+        return s.size();
+    });
+    run(name, "format_exact", [&] { return exact::format_exact(f, args...).size(); });
+    run(name, "format_small", [&] { return exact::format_small(f, args...).size(); });
+    run(name, "format_into", [&] {
+        char storage[4096];
+        exact::Arena arena(storage);
+        auto s = exact::format_into(arena, f, args...);
+        return s ? s->size() : 0;
+    });
+}
+
+int main()
+{
+    int i = 10;
+    double d = 1.234;
+    string s = "Hello World!";
+    string long_s(600, 'x');
+
+    print("{:<10} {:<16} {:>10} {:>10} {:>12}\n", "message", "method", "ns/call", "MB/s", "allocations");
+    run_all("short", "{} {} {}", i, d, s);
+    run_all("medium", "Request {} for {} took {:.3f} ms and returned {} bytes: {}", i, s, d, 4096, s);
+    run_all("long", "{} {} {}: {}", i, d, s, long_s);
+}
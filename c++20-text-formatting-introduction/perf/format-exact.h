@@ -0,0 +1,176 @@
+// Formatting functions that allocate at most once, and then exactly the right
+// amount.
+//
+// code/formatted_size.cpp finds the length of the output with formatted_size
+// and then calls format, so everything is formatted twice, and format itself
+// still grows its string as it goes. These functions format into a buffer on
+// the stack with format_to_n first. That gives the full length of the output
+// even when it doesn't fit, so only output longer than the stack buffer is
+// formatted a second time, straight into storage of the right size.
+//
+//   format_exact(f, args...)     - returns a std::string, allocated once with
+//                                  exactly the right size, or not at all if
+//                                  it fits in the string's own small buffer
+//   format_small<N>(f, args...)  - returns a SmallString<N>, which holds up to
+//                                  N characters without allocating
+//   format_into(arena, f, args...) - appends to an Arena, memory owned by the
+//                                  caller, and never allocates
+
+#ifndef PERF_FORMAT_EXACT_H
+#define PERF_FORMAT_EXACT_H
+
+#include <fmt/format.h>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace exact
+{
+
+// The size of the stack buffer tried first.
+constexpr std::size_t stack_size = 256;
+
+template<class... Args>
+std::string format_exact(fmt::format_string<Args...> f, Args&&... args)
+{
+    char buf[stack_size];
+    auto result = fmt::format_to_n(buf, stack_size, f, args...);
+    if (result.size <= stack_size)
+    {
+        return std::string(buf, result.size);
+    }
+    std::string s(result.size, '\0');
+    fmt::format_to_n(s.data(), s.size(), f, args...);
+    return s;
+}
+
+// A string holding up to N characters inside itself, or longer ones in a
+// heap block of exactly the right size.
+template<std::size_t N>
+class SmallString
+{
+public:
+    SmallString() = default;
+
+    SmallString(SmallString&& other) noexcept
+    : size_(other.size_), heap_(std::move(other.heap_))
+    {
+        if (!heap_)
+        {
+            std::memcpy(inline_, other.inline_, size_);
+        }
+        other.size_ = 0;
+    }
+
+    SmallString& operator=(SmallString&& other) noexcept
+    {
+        if (this != &other)
+        {
+            size_ = other.size_;
+            heap_ = std::move(other.heap_);
+            if (!heap_)
+            {
+                std::memcpy(inline_, other.inline_, size_);
+            }
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    const char* data() const { return heap_ ? heap_.get() : inline_; }
+    std::size_t size() const { return size_; }
+    bool on_heap() const { return heap_ != nullptr; }
+
+    operator std::string_view() const { return {data(), size_}; }
+    std::string_view view() const { return {data(), size_}; }
+
+    // For format_small: the inline storage, and storage for n characters,
+    // which is the inline storage if they fit.
+    char* inline_buffer() { return inline_; }
+
+    char* resize(std::size_t n)
+    {
+        size_ = n;
+        if (n <= N)
+        {
+            heap_.reset();
+            return inline_;
+        }
+        heap_.reset(new char[n]);
+        return heap_.get();
+    }
+
+private:
+    std::size_t size_ = 0;
+    std::unique_ptr<char[]> heap_;
+    char inline_[N];
+};
+
+template<std::size_t N = stack_size, class... Args>
+SmallString<N> format_small(fmt::format_string<Args...> f, Args&&... args)
+{
+    SmallString<N> s;
+    auto result = fmt::format_to_n(s.inline_buffer(), N, f, args...);
+    auto p = s.resize(result.size);
+    if (result.size > N)
+    {
+        fmt::format_to_n(p, result.size, f, args...);
+    }
+    return s;
+}
+
+// A region of memory owned by the caller that formatted strings are appended
+// to. The strings stay valid until the arena is reset or the memory goes.
+class Arena
+{
+public:
+    Arena(char* data, std::size_t capacity)
+    : data_(data), capacity_(capacity)
+    {
+    }
+
+    template<std::size_t N>
+    explicit Arena(char (&data)[N])
+    : Arena(data, N)
+    {
+    }
+
+    std::size_t used() const { return used_; }
+    std::size_t capacity() const { return capacity_; }
+    std::string_view contents() const { return {data_, used_}; }
+    void reset() { used_ = 0; }
+
+    // Where the next string goes, how much room there is for it, and adding
+    // n characters there to the arena.
+    char* next() { return data_ + used_; }
+    std::size_t room() const { return capacity_ - used_; }
+    void commit(std::size_t n) { used_ += n; }
+
+private:
+    char* data_;
+    std::size_t capacity_;
+    std::size_t used_ = 0;
+};
+
+// Append to the arena, and return the new text, or nothing if there wasn't
+// room for it, in which case the arena is unchanged.
+template<class... Args>
+std::optional<std::string_view> format_into(Arena& arena, fmt::format_string<Args...> f, Args&&... args)
+{
+    auto start = arena.next();
+    auto result = fmt::format_to_n(start, arena.room(), f, args...);
+    if (result.size > arena.room())
+    {
+        return std::nullopt;
+    }
+    arena.commit(result.size);
+    return std::string_view(start, result.size);
+}
+
+} // namespace exact
+
+#endif // PERF_FORMAT_EXACT_H
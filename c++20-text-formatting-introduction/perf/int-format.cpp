@@ -0,0 +1,127 @@
+#include <fmt/format.h>
+#include <cstdint>
+#include <iostream>
+#include <locale>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include "int-format.h"
+#include "timing.h"
+
+// Formats a million int32, int64 and uint64 values with each spec below,
+// each followed by a space, with fmt::format_to one value at a time and with
+// intfmt::format_all using the table and SIMD kernels. The values have a mix
+// of lengths, so the branches on the length aren't all predicted.
+//
+// For {:L} fmt is given a locale that groups digits in threes with ',', which
+// is what intfmt does without one.
+
+using namespace std;
+using namespace fmt;
+
+struct Commas : numpunct<char>
+{
+    char do_thousands_sep() const override { return ','; }
+    std::string do_grouping() const override { return "\3"; }
+};
+
+const locale commas(locale::classic(), new Commas);
+
+const char* specs[] = {"", "x", "#x", "X", "b", "08", "+020", "#018x", "L"};
+
+bool ok = true;
+
+template<class T>
+string with_fmt(const vector<T>& values, const string& f)
+{
+    memory_buffer buf;
+    for (auto v: values)
+    {
+        format_to(back_inserter(buf), commas, runtime(f), v);
+    }
+    return to_string(buf);
+}
+
+template<class T>
+size_t with_intfmt(const vector<T>& values, const intfmt::Spec& spec, vector<char>& out, intfmt::Kernel kernel)
+{
+    auto end = intfmt::format_all(span<const T>(values), spec, " ", out.data(), kernel);
+    return end - out.data();
+}
+
+void report(std::string_view type, std::string_view spec, std::string_view method, size_t count, const perf::Timing& t)
+{
+    print("{:<8} {:<8} {:<14} {:>10.2f} {:>10.1f} {:>10.1f}\n", type, spec, method, t.ns_per_call / 1e6,
+          count / t.ns_per_call * 1e3, t.mb_per_sec());
+}
+
+template<class T>
+void run(std::string_view type, const vector<T>& values)
+{
+    vector<char> out;
+    for (const char* s: specs)
+    {
+        auto spec = intfmt::parse_spec(s);
+        if (is_unsigned_v<T> && spec.sign != '-')
+        {
+            continue;   // fmt only allows a sign for signed types
+        }
+        string f = std::string("{:") + s + "} ";
+        auto expected = with_fmt(values, f);
+        out.resize(values.size() * intfmt::max_size<T>(spec, " "));
+        for (auto kernel: {intfmt::Kernel::table, intfmt::Kernel::simd})
+        {
+            auto n = with_intfmt(values, spec, out, kernel);
+            if (std::string_view(out.data(), n) != expected)
+            {
+                cerr << "intfmt gives different text for " << type << " {:" << s << "}\n";
+                ok = false;
+                return;
+            }
+        }
+
+        std::string_view name = *s ? s : "{}";
+        report(type, name, "fmt::format_to", values.size(), perf::time_calls([&] {
+            memory_buffer buf;
+            for (auto v: values)
+            {
+                format_to(back_inserter(buf), runtime(f), v);
+            }
+            return buf.size();
+        }));
+        report(type, name, "intfmt table", values.size(), perf::time_calls([&] {
+            return with_intfmt(values, spec, out, intfmt::Kernel::table);
+        }));
+        report(type, name, "intfmt simd", values.size(), perf::time_calls([&] {
+            return with_intfmt(values, spec, out, intfmt::Kernel::simd);
+        }));
+    }
+}
+
+int main()
+{
+    constexpr size_t count = 1'000'000;
+    mt19937_64 rng(42);
+    vector<int32_t> i32;
+    vector<int64_t> i64;
+    vector<uint64_t> u64;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t r = rng();
+        uint64_t v = r >> (rng() % 64);
+        u64.push_back(v);
+        i64.push_back(r & 1 ? -static_cast<int64_t>(v >> 1) : static_cast<int64_t>(v >> 1));
+        i32.push_back(static_cast<int32_t>(i64.back() >> 32));
+    }
+    i32.back() = numeric_limits<int32_t>::min();
+    i64.back() = numeric_limits<int64_t>::min();
+    u64.back() = numeric_limits<uint64_t>::max();
+
+    print("{:<8} {:<8} {:<14} {:>10} {:>10} {:>10}\n", "type", "spec", "method", "ms/call", "Mval/s", "MB/s");
+    run("int32", i32);
+    run("int64", i64);
+    run("uint64", u64);
+
+    return ok ? 0 : 1;
+}
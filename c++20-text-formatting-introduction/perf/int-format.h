@@ -0,0 +1,527 @@
+// Formatting arrays of integers in decimal, hex or binary, for the case where
+// there are millions of them with the same spec, as in a log or CSV export.
+//
+// fmt::format_to with "{:x}" and the like parses the spec and works out how to
+// handle it for every value. Here the spec is parsed once, into a Spec, and
+// format_all() formats a whole span with it into one buffer. The digits are
+// generated in one of two ways, so they can be compared:
+//
+//   Kernel::table - from the least significant end, two decimal digits or two
+//                   hex digits at a time from lookup tables
+//   Kernel::simd  - decimal digits eight at a time with SSE2 (sixteen with
+//                   AVX2 if the processor has it), hex digits sixteen at a
+//                   time with SSSE3
+//
+// Binary uses a table giving the eight characters for each byte in both.
+//
+// The specs understood are the integer subset of fmt's:
+//
+//   [sign]['#']['0'][width]['L'][type]
+//
+// where sign is '+', '-' or ' ', '#' adds a 0x or 0b prefix, '0' pads with
+// zeros after the sign and prefix rather than spaces before them, and type is
+// one of d, x, X, b or B. Numbers are right-aligned, as fmt does by default.
+// 'L' groups decimal digits in threes with Spec::group, ',' unless changed,
+// instead of taking the separator from a locale. Anything else throws
+// fmt::format_error.
+
+#ifndef PERF_INT_FORMAT_H
+#define PERF_INT_FORMAT_H
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INTFMT_X86 1
+#endif
+
+namespace intfmt
+{
+
+enum class Base { dec, hex, bin };
+
+enum class Kernel { table, simd };
+
+struct Spec
+{
+    Base base = Base::dec;
+    bool upper = false;     // X or B
+    char sign = '-';        // '-', '+' or ' '
+    bool alt = false;       // '#'
+    bool zero_pad = false;  // '0'
+    unsigned width = 0;
+    char group = 0;         // separator between groups of three digits, or 0
+};
+
+inline Spec parse_spec(std::string_view s)
+{
+    Spec spec;
+    std::size_t i = 0;
+    auto at = [&](char c) { return i < s.size() && s[i] == c; };
+    if (at('+') || at('-') || at(' '))
+    {
+        spec.sign = s[i++];
+    }
+    if (at('#'))
+    {
+        spec.alt = true;
+        ++i;
+    }
+    if (at('0'))
+    {
+        spec.zero_pad = true;
+        ++i;
+    }
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9')
+    {
+        spec.width = spec.width * 10 + (s[i++] - '0');
+    }
+    if (at('L'))
+    {
+        spec.group = ',';
+        ++i;
+    }
+    if (i < s.size())
+    {
+        switch (s[i++])
+        {
+        case 'd': break;
+        case 'x': spec.base = Base::hex; break;
+        case 'X': spec.base = Base::hex; spec.upper = true; break;
+        case 'b': spec.base = Base::bin; break;
+        case 'B': spec.base = Base::bin; spec.upper = true; break;
+        default: throw fmt::format_error("invalid type specifier");
+        }
+    }
+    if (i != s.size())
+    {
+        throw fmt::format_error("unsupported format specifier");
+    }
+    return spec;
+}
+
+namespace detail
+{
+
+struct Tables
+{
+    char dec2[200];
+    char hex2[2][512];
+    char hex16[2][16];
+    std::uint64_t bin8[256];    // the characters for each byte, first in the low byte
+
+    constexpr Tables()
+    : dec2(), hex2(), hex16(), bin8()
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            dec2[i * 2] = static_cast<char>('0' + i / 10);
+            dec2[i * 2 + 1] = static_cast<char>('0' + i % 10);
+        }
+        const char* digits[2] = {"0123456789abcdef", "0123456789ABCDEF"};
+        for (int u = 0; u < 2; ++u)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                hex16[u][i] = digits[u][i];
+            }
+            for (int i = 0; i < 256; ++i)
+            {
+                hex2[u][i * 2] = digits[u][i >> 4];
+                hex2[u][i * 2 + 1] = digits[u][i & 15];
+            }
+        }
+        for (int b = 0; b < 256; ++b)
+        {
+            std::uint64_t chars = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                chars |= std::uint64_t('0' + ((b >> (7 - i)) & 1)) << (8 * i);
+            }
+            bin8[b] = chars;
+        }
+    }
+};
+
+inline constexpr Tables tables{};
+
+inline constexpr std::uint64_t pow10[20] = {
+    1ull, 10ull, 100ull, 1'000ull, 10'000ull, 100'000ull, 1'000'000ull, 10'000'000ull,
+    100'000'000ull, 1'000'000'000ull, 10'000'000'000ull, 100'000'000'000ull,
+    1'000'000'000'000ull, 10'000'000'000'000ull, 100'000'000'000'000ull,
+    1'000'000'000'000'000ull, 10'000'000'000'000'000ull, 100'000'000'000'000'000ull,
+    1'000'000'000'000'000'000ull, 10'000'000'000'000'000'000ull,
+};
+
+inline int count_dec(std::uint64_t v)
+{
+    int t = ((64 - std::countl_zero(v | 1)) * 1233) >> 12;
+    return std::max(1, t + (v >= pow10[t]));
+}
+
+inline int count_hex(std::uint64_t v)
+{
+    return std::max(1, (64 - std::countl_zero(v) + 3) / 4);
+}
+
+inline int count_bin(std::uint64_t v)
+{
+    return std::max(1, 64 - std::countl_zero(v));
+}
+
+inline char* dec_table(std::uint64_t v, char* out)
+{
+    int n = count_dec(v);
+    char* p = out + n;
+    while (v >= 100)
+    {
+        p -= 2;
+        std::memcpy(p, tables.dec2 + (v % 100) * 2, 2);
+        v /= 100;
+    }
+    if (v >= 10)
+    {
+        std::memcpy(p - 2, tables.dec2 + v * 2, 2);
+    }
+    else
+    {
+        p[-1] = static_cast<char>('0' + v);
+    }
+    return out + n;
+}
+
+inline char* hex_table(std::uint64_t v, bool upper, char* out)
+{
+    int n = count_hex(v);
+    char* p = out + n;
+    const char* t = tables.hex2[upper];
+    while (v >= 256)
+    {
+        p -= 2;
+        std::memcpy(p, t + (v & 0xff) * 2, 2);
+        v >>= 8;
+    }
+    if (v >= 16)
+    {
+        std::memcpy(p - 2, t + v * 2, 2);
+    }
+    else
+    {
+        p[-1] = tables.hex16[upper][v];
+    }
+    return out + n;
+}
+
+inline char* bin_table(std::uint64_t v, char* out)
+{
+    int n = count_bin(v);
+    char chars[64];
+    for (int i = 0; i < 8; ++i)
+    {
+        std::memcpy(chars + i * 8, &tables.bin8[(v >> (56 - i * 8)) & 0xff], 8);
+    }
+    std::memcpy(out, chars + 64 - n, n);
+    return out + n;
+}
+
+#ifdef INTFMT_X86
+
+// The eight decimal digits of v, which must be below 100,000,000, as byte
+// values 0 to 9 in the low eight bytes, most significant first.
+//
+// v is split into two four digit halves, each copied into four 16-bit lanes.
+// Multiplying by a fixed-point reciprocal and keeping the high half, twice,
+// gives x / 1000, x / 100 and x / 10 in the first three lanes of each half,
+// exactly for every x below 10,000, and the fourth keeps x. Subtracting ten
+// times the lane before from each lane leaves one digit per lane.
+inline __m128i dec8_digits(std::uint32_t v)
+{
+    auto hi = static_cast<short>(v / 10'000);
+    auto lo = static_cast<short>(v % 10'000);
+    __m128i x = _mm_set_epi16(lo, lo, lo, lo, hi, hi, hi, hi);
+    const __m128i c1 = _mm_set_epi16(0, -13107, 5243, 8389, 0, -13107, 5243, 8389);   // -13107 is 52429
+    const __m128i c2 = _mm_set_epi16(0, 8192, 8192, 512, 0, 8192, 8192, 512);
+    const __m128i keep = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i q = _mm_mulhi_epu16(_mm_mulhi_epu16(x, c1), c2);
+    q = _mm_or_si128(_mm_andnot_si128(keep, q), _mm_and_si128(keep, x));
+    __m128i d = _mm_sub_epi16(q, _mm_mullo_epi16(_mm_slli_epi64(q, 16), _mm_set1_epi16(10)));
+    return _mm_packus_epi16(d, d);
+}
+
+// Write the eight digits of v, or with strip, leave out the leading zeros.
+inline char* dec8_simd(std::uint32_t v, char* out, bool strip)
+{
+    __m128i d = dec8_digits(v);
+    __m128i chars = _mm_add_epi8(d, _mm_set1_epi8('0'));
+    if (!strip)
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), chars);
+        return out + 8;
+    }
+    unsigned zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128()));
+    int skip = std::countr_zero(~zeros);
+    alignas(16) char tmp[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(tmp), chars);
+    std::memcpy(out, tmp + skip, 8 - skip);
+    return out + 8 - skip;
+}
+
+// As dec8_simd but sixteen digits at once, for v below 10^16.
+__attribute__((target("avx2")))
+inline char* dec16_avx2(std::uint64_t v, char* out, bool strip)
+{
+    auto a = static_cast<std::uint32_t>(v / 100'000'000);
+    auto b = static_cast<std::uint32_t>(v % 100'000'000);
+    auto h0 = static_cast<short>(a / 10'000), h1 = static_cast<short>(a % 10'000);
+    auto h2 = static_cast<short>(b / 10'000), h3 = static_cast<short>(b % 10'000);
+    __m256i x = _mm256_set_epi16(h3, h3, h3, h3, h2, h2, h2, h2, h1, h1, h1, h1, h0, h0, h0, h0);
+    const __m256i c1 = _mm256_set_epi16(0, -13107, 5243, 8389, 0, -13107, 5243, 8389,
+                                        0, -13107, 5243, 8389, 0, -13107, 5243, 8389);
+    const __m256i c2 = _mm256_set_epi16(0, 8192, 8192, 512, 0, 8192, 8192, 512,
+                                        0, 8192, 8192, 512, 0, 8192, 8192, 512);
+    const __m256i keep = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+    __m256i q = _mm256_mulhi_epu16(_mm256_mulhi_epu16(x, c1), c2);
+    q = _mm256_or_si256(_mm256_andnot_si256(keep, q), _mm256_and_si256(keep, x));
+    __m256i d = _mm256_sub_epi16(q, _mm256_mullo_epi16(_mm256_slli_epi64(q, 16), _mm256_set1_epi16(10)));
+    // The pack works within each 128-bit half, so move the two sets of eight
+    // digits together afterwards.
+    d = _mm256_permute4x64_epi64(_mm256_packus_epi16(d, d), 0b1000);
+    __m128i digits = _mm256_castsi256_si128(d);
+    __m128i chars = _mm_add_epi8(digits, _mm_set1_epi8('0'));
+    if (!strip)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+        return out + 16;
+    }
+    unsigned zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(digits, _mm_setzero_si128()));
+    int skip = std::countr_zero(~zeros);
+    alignas(16) char tmp[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(tmp), chars);
+    std::memcpy(out, tmp + skip, 16 - skip);
+    return out + 16 - skip;
+}
+
+inline const bool have_avx2 = __builtin_cpu_supports("avx2");
+inline const bool have_ssse3 = __builtin_cpu_supports("ssse3");
+
+// The sixteen digits of v below 10^16, or without its leading zeros.
+inline char* dec16_simd(std::uint64_t v, char* out, bool strip)
+{
+    if (have_avx2)
+    {
+        return dec16_avx2(v, out, strip);
+    }
+    auto hi = static_cast<std::uint32_t>(v / 100'000'000);
+    auto lo = static_cast<std::uint32_t>(v % 100'000'000);
+    if (strip && hi == 0)
+    {
+        return dec8_simd(lo, out, true);
+    }
+    out = dec8_simd(hi, out, strip);
+    return dec8_simd(lo, out, false);
+}
+
+inline char* dec_simd(std::uint64_t v, char* out)
+{
+    if (v < 100)
+    {
+        return dec_table(v, out);
+    }
+    if (v < 100'000'000)
+    {
+        return dec8_simd(static_cast<std::uint32_t>(v), out, true);
+    }
+    if (v < pow10[16])
+    {
+        return dec16_simd(v, out, true);
+    }
+    out = dec_table(v / pow10[16], out);
+    return dec16_simd(v % pow10[16], out, false);
+}
+
+// Each byte of v, most significant first, is split into its two nibbles,
+// which are looked up in the sixteen hex digits with a byte shuffle.
+__attribute__((target("ssse3")))
+inline char* hex_ssse3(std::uint64_t v, bool upper, char* out)
+{
+    int n = count_hex(v);
+    __m128i x = _mm_cvtsi64_si128(static_cast<long long>(__builtin_bswap64(v)));
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i lo = _mm_and_si128(x, mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+    __m128i nibbles = _mm_unpacklo_epi8(hi, lo);
+    __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.hex16[upper]));
+    alignas(16) char tmp[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(tmp), _mm_shuffle_epi8(digits, nibbles));
+    std::memcpy(out, tmp + 16 - n, n);
+    return out + n;
+}
+
+inline char* hex_simd(std::uint64_t v, bool upper, char* out)
+{
+    return have_ssse3 ? hex_ssse3(v, upper, out) : hex_table(v, upper, out);
+}
+
+#else
+
+inline char* dec_simd(std::uint64_t v, char* out) { return dec_table(v, out); }
+inline char* hex_simd(std::uint64_t v, bool upper, char* out) { return hex_table(v, upper, out); }
+
+#endif
+
+template<Base B, Kernel K>
+char* digits(std::uint64_t v, bool upper, char* out)
+{
+    if constexpr (B == Base::dec)
+    {
+        return K == Kernel::simd ? dec_simd(v, out) : dec_table(v, out);
+    }
+    else if constexpr (B == Base::hex)
+    {
+        return K == Kernel::simd ? hex_simd(v, upper, out) : hex_table(v, upper, out);
+    }
+    else
+    {
+        return bin_table(v, out);
+    }
+}
+
+// Copy n digits, putting sep between each group of three from the right.
+inline char* grouped(const char* digits, int n, char sep, char* out)
+{
+    int first = n % 3 == 0 ? 3 : n % 3;
+    std::memcpy(out, digits, first);
+    out += first;
+    for (int i = first; i < n; i += 3)
+    {
+        *out++ = sep;
+        std::memcpy(out, digits + i, 3);
+        out += 3;
+    }
+    return out;
+}
+
+template<Base B, Kernel K, class T>
+char* format_value(T value, const Spec& spec, char* out)
+{
+    using U = std::make_unsigned_t<T>;
+    auto u = static_cast<std::uint64_t>(static_cast<U>(value));
+    bool negative = false;
+    if constexpr (std::is_signed_v<T>)
+    {
+        if (value < 0)
+        {
+            negative = true;
+            u = static_cast<std::uint64_t>(U(0) - static_cast<U>(value));
+        }
+    }
+
+    char head[4];
+    int head_size = 0;
+    if (negative)
+    {
+        head[head_size++] = '-';
+    }
+    else if (spec.sign != '-')
+    {
+        head[head_size++] = spec.sign;
+    }
+    if (spec.alt && B != Base::dec)
+    {
+        head[head_size++] = '0';
+        head[head_size++] = B == Base::hex ? (spec.upper ? 'X' : 'x') : (spec.upper ? 'B' : 'b');
+    }
+
+    if (spec.width == 0 && !spec.group)
+    {
+        std::memcpy(out, head, head_size);
+        return digits<B, K>(u, spec.upper, out + head_size);
+    }
+
+    char body[96];
+    char* end = digits<B, K>(u, spec.upper, body);
+    int n = static_cast<int>(end - body);
+    int shown = B == Base::dec && spec.group ? n + (n - 1) / 3 : n;
+    int pad = std::max(0, static_cast<int>(spec.width) - head_size - shown);
+    if (!spec.zero_pad)
+    {
+        std::memset(out, ' ', pad);
+        out += pad;
+    }
+    std::memcpy(out, head, head_size);
+    out += head_size;
+    if (spec.zero_pad)
+    {
+        std::memset(out, '0', pad);
+        out += pad;
+    }
+    if (B == Base::dec && spec.group)
+    {
+        return grouped(body, n, spec.group, out);
+    }
+    std::memcpy(out, body, n);
+    return out + n;
+}
+
+template<Base B, Kernel K, class T>
+char* format_span(std::span<const T> values, const Spec& spec, std::string_view sep, char* out)
+{
+    for (auto v: values)
+    {
+        out = format_value<B, K>(v, spec, out);
+        std::memcpy(out, sep.data(), sep.size());
+        out += sep.size();
+    }
+    return out;
+}
+
+} // namespace detail
+
+// The most characters format_all() can write for each value, including the
+// separator.
+template<class T>
+std::size_t max_size(const Spec& spec, std::string_view sep)
+{
+    std::size_t n = std::numeric_limits<T>::digits + std::is_signed_v<T>;
+    return std::max<std::size_t>(n + n / 3 + 3, spec.width) + sep.size();
+}
+
+// Format every value, each followed by sep, into out, which must have room
+// for values.size() * max_size<T>(spec, sep) characters. Returns the end of
+// the output.
+template<class T>
+char* format_all(std::span<const T> values, const Spec& spec, std::string_view sep, char* out,
+                 Kernel kernel = Kernel::simd)
+{
+    static_assert(std::is_integral_v<T> && sizeof(T) <= 8, "format_all only formats integers");
+    using detail::format_span;
+    if (kernel == Kernel::simd)
+    {
+        switch (spec.base)
+        {
+        case Base::dec: return format_span<Base::dec, Kernel::simd>(values, spec, sep, out);
+        case Base::hex: return format_span<Base::hex, Kernel::simd>(values, spec, sep, out);
+        case Base::bin: return format_span<Base::bin, Kernel::simd>(values, spec, sep, out);
+        }
+    }
+    switch (spec.base)
+    {
+    case Base::dec: return format_span<Base::dec, Kernel::table>(values, spec, sep, out);
+    case Base::hex: return format_span<Base::hex, Kernel::table>(values, spec, sep, out);
+    case Base::bin: return format_span<Base::bin, Kernel::table>(values, spec, sep, out);
+    }
+    return out;
+}
+
+} // namespace intfmt
+
+#endif // PERF_INT_FORMAT_H
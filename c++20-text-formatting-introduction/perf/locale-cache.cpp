@@ -0,0 +1,166 @@
+#include <fmt/format.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <locale>
+#include <string>
+#include <thread>
+#include <vector>
+#include "locale-cache.h"
+#include "timing.h"
+
+// Compares ways of formatting the line from code/locale.cpp,
+// "{:.2Lf} {:12Ld}", with German separators, on several threads at once:
+//
+//   locale per call  - format(locale("de_DE"), ...) as locale.cpp does
+//   global locale    - locale::global set once, then format(...) with L
+//   shared locale    - one std::locale made up front and passed to format
+//   localefmt        - localefmt::format with the cached separators
+//
+// Usage: locale-cache [threads [calls per thread]]
+//
+// If de_DE isn't installed, a locale with a numpunct facet giving the same
+// separators is used instead, and "locale per call" makes that, which is
+// quicker than reading a locale by name.
+
+using namespace std;
+using namespace fmt;
+
+using clock_type = chrono::steady_clock;
+
+struct GermanNumpunct : numpunct<char>
+{
+    char do_decimal_point() const override { return ','; }
+    char do_thousands_sep() const override { return '.'; }
+    std::string do_grouping() const override { return "\3"; }
+};
+
+const char* locale_name = nullptr;
+
+locale german()
+{
+    if (locale_name)
+    {
+        return locale(locale_name);
+    }
+    return locale(locale::classic(), new GermanNumpunct);
+}
+
+void find_german()
+{
+    for (const char* name: {"de_DE.UTF-8", "de_DE.utf8", "de_DE"})
+    {
+        try
+        {
+            locale loc(name);
+            locale_name = name;
+            return;
+        }
+        catch (const runtime_error&)
+        {
+        }
+    }
+}
+
+double dval(size_t i) { return static_cast<double>(i % 100'000) * 12.5 + 0.25; }
+int ival(size_t i) { return static_cast<int>(i * 7919 % 100'000'000); }
+
+struct PerCall
+{
+    static constexpr const char* name = "locale per call";
+    string operator()(size_t i) const { return format(german(), "{:.2Lf} {:12Ld}", dval(i), ival(i)); }
+};
+
+struct Global
+{
+    static constexpr const char* name = "global locale";
+    string operator()(size_t i) const { return format("{:.2Lf} {:12Ld}", dval(i), ival(i)); }
+};
+
+struct Shared
+{
+    static constexpr const char* name = "shared locale";
+    const locale& loc;
+    string operator()(size_t i) const { return format(loc, "{:.2Lf} {:12Ld}", dval(i), ival(i)); }
+};
+
+struct Cached
+{
+    static constexpr const char* name = "localefmt";
+    const localefmt::Numpunct& np;
+    string operator()(size_t i) const { return localefmt::format(np, "{:.2Lf} {:12Ld}", dval(i), ival(i)); }
+};
+
+template<class F>
+void run(F f, int threads, size_t calls)
+{
+    atomic<bool> go{false};
+    atomic<size_t> bytes{0};
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            while (!go.load(memory_order_acquire))
+            {
+                this_thread::yield();
+            }
+            size_t n = 0;
+            for (size_t i = 0; i < calls; ++i)
+            {
+                n += f(i + t * calls).size();
+            }
+            bytes += n;
+        });
+    }
+    auto begin = clock_type::now();
+    go.store(true, memory_order_release);
+    for (auto& w: workers)
+    {
+        w.join();
+    }
+    chrono::duration<double, std::nano> elapsed = clock_type::now() - begin;
+    perf::do_not_optimize(bytes.load());
+    double total = static_cast<double>(calls) * threads;
+    print("{:<18} {:>8} {:>12.1f} {:>12.2f}\n", F::name, threads, elapsed.count() / calls,
+          total / elapsed.count() * 1e3);
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : static_cast<int>(max(2u, thread::hardware_concurrency()));
+    size_t calls = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200'000;
+
+    find_german();
+    if (locale_name)
+    {
+        print("Using locale {}\n\n", locale_name);
+    }
+    else
+    {
+        print("de_DE isn't installed, using a numpunct facet with the same separators\n\n");
+    }
+    locale shared = german();
+    locale::global(shared);
+    const auto& np = localefmt::add("de_DE", shared);
+
+    for (size_t i: {0, 1, 12345, 99999})
+    {
+        auto expected = PerCall{}(i);
+        if (Global{}(i) != expected || Shared{shared}(i) != expected || Cached{np}(i) != expected)
+        {
+            cerr << "The methods give different text for " << expected << "\n";
+            return 1;
+        }
+    }
+    print("{}\n\n", PerCall{}(12345));
+
+    print("{:<18} {:>8} {:>12} {:>12}\n", "method", "threads", "ns/call", "Mcalls/s");
+    for (int t: {1, threads})
+    {
+        run(PerCall{}, t, calls / 4);
+        run(Global{}, t, calls);
+        run(Shared{shared}, t, calls);
+        run(Cached{np}, t, calls);
+    }
+}
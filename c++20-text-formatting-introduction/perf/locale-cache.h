@@ -0,0 +1,371 @@
+// Locale-specific number formatting, the {:L} specs in code/locale.cpp,
+// without making a std::locale for each call or changing the global one.
+//
+// code/locale.cpp either sets the global locale, which affects every thread,
+// or passes a newly made locale("de_DE") to each format call. Making a locale
+// by name reads the locale database every time, and for each {:L} value fmt
+// looks up the numpunct facet and copies its grouping string.
+//
+// Here the decimal point, thousands separator and grouping of each locale are
+// read once into a Numpunct, kept for the life of the program, and shared by
+// all threads:
+//
+//     auto& de = localefmt::get("de_DE");
+//     auto s = localefmt::format(de, "{:.2Lf} {:12Ld}", 1.5, 1'000'000);
+//
+// gives "1,50    1.000.000". The format string is checked at compile time as
+// for fmt::format. Specs with L are handled here; others go to fmt unchanged.
+// Locales made from facets rather than a name can be added under a name with
+// localefmt::add().
+
+#ifndef PERF_LOCALE_CACHE_H
+#define PERF_LOCALE_CACHE_H
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <locale>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include "float-format.h"
+
+namespace localefmt
+{
+
+struct Numpunct
+{
+    std::string name;
+    char decimal_point = '.';
+    char thousands_sep = ',';
+    std::string grouping;   // as std::numpunct::grouping: group sizes from the right
+
+    Numpunct(std::string_view n, const std::locale& loc)
+    : name(n)
+    {
+        const auto& facet = std::use_facet<std::numpunct<char>>(loc);
+        decimal_point = facet.decimal_point();
+        thousands_sep = facet.thousands_sep();
+        grouping = facet.grouping();
+    }
+};
+
+namespace detail
+{
+
+class Cache
+{
+public:
+    static Cache& instance()
+    {
+        static Cache cache;
+        return cache;
+    }
+
+    const Numpunct& get(std::string_view name)
+    {
+        {
+            std::shared_lock lock(mutex_);
+            auto it = entries_.find(name);
+            if (it != entries_.end())
+            {
+                return *it->second;
+            }
+        }
+        // Made outside the lock, as it can take a while, and throws
+        // std::runtime_error if there is no such locale.
+        std::locale loc{std::string(name)};
+        return add(name, loc);
+    }
+
+    const Numpunct& add(std::string_view name, const std::locale& loc)
+    {
+        auto entry = std::make_unique<Numpunct>(name, loc);
+        std::unique_lock lock(mutex_);
+        auto [it, inserted] = entries_.try_emplace(std::string(name), std::move(entry));
+        return *it->second;
+    }
+
+private:
+    Cache() = default;
+
+    std::shared_mutex mutex_;
+    // Never erased, so references handed out stay valid.
+    std::map<std::string, std::unique_ptr<Numpunct>, std::less<>> entries_;
+};
+
+} // namespace detail
+
+// The separators for the named locale, read from std::locale(name) the first
+// time the name is asked for.
+inline const Numpunct& get(std::string_view name)
+{
+    return detail::Cache::instance().get(name);
+}
+
+// Use the separators of loc for name, unless name is already known.
+inline const Numpunct& add(std::string_view name, const std::locale& loc)
+{
+    return detail::Cache::instance().add(name, loc);
+}
+
+namespace detail
+{
+
+// Copy the n digits at d, putting the thousands separator between groups as
+// np.grouping says.
+inline char* group_digits(const char* d, std::size_t n, const Numpunct& np, char* out)
+{
+    std::size_t seps = 0;
+    if (!np.grouping.empty())
+    {
+        std::size_t left = n;
+        for (std::size_t i = 0;; ++i)
+        {
+            int g = np.grouping[std::min(i, np.grouping.size() - 1)];
+            if (g <= 0 || g == CHAR_MAX || left <= static_cast<std::size_t>(g))
+            {
+                break;
+            }
+            left -= g;
+            ++seps;
+        }
+    }
+    char* end = out + n + seps;
+    char* p = end;
+    const char* q = d + n;
+    for (std::size_t i = 0; seps != 0; ++i, --seps)
+    {
+        std::size_t g = np.grouping[std::min(i, np.grouping.size() - 1)];
+        p -= g;
+        q -= g;
+        std::memcpy(p, q, g);
+        *--p = np.thousands_sep;
+    }
+    std::memcpy(out, d, q - d);
+    return end;
+}
+
+// Rewrite a number fmt has formatted without L with the separators of np:
+// group the digits before the point, and for floating point change the point.
+inline char* localize(std::string_view s, bool floating, const Numpunct& np, char* out)
+{
+    std::size_t i = 0;
+    if (i < s.size() && (s[i] == '-' || s[i] == '+' || s[i] == ' '))
+    {
+        *out++ = s[i++];
+    }
+    std::size_t digits = i;
+    while (digits < s.size() && s[digits] >= '0' && s[digits] <= '9')
+    {
+        ++digits;
+    }
+    if (digits == i)
+    {
+        // inf or nan
+        std::memcpy(out, s.data() + i, s.size() - i);
+        return out + s.size() - i;
+    }
+    out = group_digits(s.data() + i, digits - i, np, out);
+    if (floating && digits < s.size() && s[digits] == '.')
+    {
+        *out++ = np.decimal_point;
+        ++digits;
+    }
+    std::memcpy(out, s.data() + digits, s.size() - digits);
+    return out + s.size() - digits;
+}
+
+} // namespace detail
+
+// A value to be formatted with the separators of a cached locale.
+template<class T>
+struct Localized
+{
+    const Numpunct& np;
+    const T& value;
+};
+
+template<class T>
+constexpr bool is_number_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>;
+
+// Numbers become a Localized, which refers to the number; anything else is
+// passed on by reference.
+template<class T>
+using wrapped_t = std::conditional_t<is_number_v<T>, Localized<T>, const T&>;
+
+template<class T>
+wrapped_t<T> wrap(const Numpunct& np, const T& value)
+{
+    if constexpr (is_number_v<T>)
+    {
+        return Localized<T>{np, value};
+    }
+    else
+    {
+        return value;
+    }
+}
+
+// make_format_args keeps references to its arguments, so the wrapped ones
+// are held in a tuple for the length of the call.
+template<class... Args>
+std::string format(const Numpunct& np, fmt::format_string<const Args&...> f, const Args&... args)
+{
+    std::tuple<wrapped_t<Args>...> wrapped(wrap(np, args)...);
+    return std::apply([&](const auto&... w) { return fmt::vformat(fmt::string_view(f), fmt::make_format_args(w...)); },
+                      wrapped);
+}
+
+template<class OutputIt, class... Args>
+OutputIt format_to(OutputIt out, const Numpunct& np, fmt::format_string<const Args&...> f, const Args&... args)
+{
+    std::tuple<wrapped_t<Args>...> wrapped(wrap(np, args)...);
+    return std::apply(
+        [&](const auto&... w) { return fmt::vformat_to(out, fmt::string_view(f), fmt::make_format_args(w...)); },
+        wrapped);
+}
+
+} // namespace localefmt
+
+// Without L in the spec the value goes straight to fmt's formatter. With it,
+// the fill, alignment, '0' and width are taken off the spec, the value is
+// formatted with the rest, by fmt or for doubles by floatfmt::Formatter, the
+// separators are put in, and then it is padded. The
+// padding follows the standard: fmt 9 leaves floating point one short of the
+// width and puts '0' padding before the sign.
+template<class T>
+struct fmt::formatter<localefmt::Localized<T>>
+{
+    auto parse(format_parse_context& ctx)
+    {
+        auto begin = ctx.begin();
+        auto end = begin;
+        while (end != ctx.end() && *end != '}')
+        {
+            ++end;
+        }
+        std::string_view spec(begin, end - begin);
+        // fmt only uses the locale for decimal integers, and not for hex
+        // floating point.
+        char type = spec.empty() || spec.back() == 'L' ? 0 : spec.back();
+        bool decimal = std::is_floating_point_v<T> ? type != 'a' && type != 'A' : type == 0 || type == 'd';
+        localized_ = decimal && spec.find('L') != spec.npos && spec.find('{') == spec.npos;
+        if (!localized_)
+        {
+            return inner_.parse(ctx);
+        }
+
+        std::size_t i = 0;
+        auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+        if (spec.size() >= 2 && is_align(spec[1]))
+        {
+            fill_ = spec[0];
+            align_ = spec[1];
+            i = 2;
+        }
+        else if (!spec.empty() && is_align(spec[0]))
+        {
+            align_ = spec[0];
+            i = 1;
+        }
+        char rest[32];
+        std::size_t n = 0;
+        while (i < spec.size() && (spec[i] == '+' || spec[i] == '-' || spec[i] == ' ' || spec[i] == '#'))
+        {
+            rest[n++] = spec[i++];
+        }
+        if (i < spec.size() && spec[i] == '0')
+        {
+            zero_ = align_ == 0;
+            ++i;
+        }
+        while (i < spec.size() && spec[i] >= '0' && spec[i] <= '9')
+        {
+            width_ = width_ * 10 + (spec[i++] - '0');
+        }
+        for (; i < spec.size(); ++i)
+        {
+            if (spec[i] != 'L')
+            {
+                if (n == sizeof(rest))
+                {
+                    throw format_error("format specifier too long");
+                }
+                rest[n++] = spec[i];
+            }
+        }
+        if constexpr (std::is_same_v<T, double>)
+        {
+            double_.emplace(std::string_view(rest, n));
+        }
+        else
+        {
+            format_parse_context inner_ctx({rest, n});
+            inner_.parse(inner_ctx);
+        }
+        return end;
+    }
+
+    template<class FormatContext>
+    auto format(const localefmt::Localized<T>& v, FormatContext& ctx) const
+    {
+        if (!localized_)
+        {
+            return inner_.format(v.value, ctx);
+        }
+        basic_memory_buffer<char, 512> plain;
+        if constexpr (std::is_same_v<T, double>)
+        {
+            plain.resize(double_->max_size());
+            plain.resize(double_->format(v.value, plain.data()) - plain.data());
+        }
+        else
+        {
+            basic_format_context<appender, char> plain_ctx(appender(plain), {});
+            inner_.format(v.value, plain_ctx);
+        }
+
+        // Each digit can gain a separator.
+        basic_memory_buffer<char, 256> text;
+        text.resize(plain.size() * 2 + 1);
+        auto end = localefmt::detail::localize({plain.data(), plain.size()}, std::is_floating_point_v<T>, v.np,
+                                               text.data());
+        std::size_t size = end - text.data();
+        std::size_t pad = width_ > size ? width_ - size : 0;
+
+        auto out = ctx.out();
+        std::string_view s(text.data(), size);
+        bool number = size != 0 && (s.back() >= '0' && s.back() <= '9');
+        if (zero_ && number)
+        {
+            std::size_t sign = s[0] == '-' || s[0] == '+' || s[0] == ' ';
+            out = std::copy(s.data(), s.data() + sign, out);
+            out = std::fill_n(out, pad, '0');
+            return std::copy(s.data() + sign, s.data() + size, out);
+        }
+        std::size_t before = align_ == '<' ? 0 : align_ == '^' ? pad / 2 : pad;
+        out = std::fill_n(out, before, fill_);
+        out = std::copy(s.data(), s.data() + size, out);
+        return std::fill_n(out, pad - before, fill_);
+    }
+
+private:
+    formatter<T> inner_;
+    std::optional<floatfmt::Formatter> double_;   // for doubles with L
+    bool localized_ = false;
+    char fill_ = ' ';
+    char align_ = 0;
+    bool zero_ = false;
+    std::size_t width_ = 0;
+};
+
+#endif // PERF_LOCALE_CACHE_H
@@ -0,0 +1,368 @@
+#include <fmt/format.h>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include "timing.h"
+
+#if __has_include(<format>)
+#include <format>
+#endif
+#if defined(__cpp_lib_format)
+#define HAVE_STD_FORMAT 1
+#endif
+
+// Times the outputs from code/printf-vs-format.cpp, one case per section of
+// that program, with each of the ways of producing the text:
+//
+//   snprintf       - into a char array
+//   fprintf        - to /dev/null, so the cost of stdio's buffering is included
+//   fmt::format    - returning a std::string
+//   fmt::format_to - into a reused fmt::memory_buffer
+//   fmt::print     - to /dev/null through stdio, like fprintf
+//   std::format    - if the standard library has it
+//   ostringstream  - a reused stream, reset before each call
+//
+// Each call returns the number of bytes it produced, to give the throughput.
+// fmt::print doesn't say how many it wrote, so that is worked out once with
+// formatted_size.
+// Give the name of a case as the argument to run only that one.
+//
+// The values are kept in variables the compiler can't see the values of, so
+// nothing is formatted at compile time.
+
+using namespace std;
+using namespace fmt;
+
+int iv = -1; short sv = -2; long lv = -3; long long llv = -4;
+unsigned int uiv = 1; unsigned short usv = 2; unsigned long ulv = 3; unsigned long long ullv = 4;
+float f = 1.234; double d = 2.345; long double ld = 3.456;
+char c = 'A';
+const char* cptr = "Mary had a little lamb";
+string str(cptr);
+std::string_view strview(str);
+int width = 10, prec = 5;
+double val = 123.456;
+float fv = 123.456;
+int neg = -1, pos = 1;
+
+char buf[256];
+FILE* devnull;
+fmt::memory_buffer mbuf;
+ostringstream oss;
+
+// Empty the stream and put back the default formatting state.
+ostringstream& fresh()
+{
+    static const auto flags = oss.flags();
+    oss.str("");
+    oss.flags(flags);
+    oss.precision(6);
+    oss.width(0);
+    return oss;
+}
+
+size_t written()
+{
+    return static_cast<size_t>(oss.tellp());
+}
+
+std::string_view only;
+
+template<class F>
+void run(std::string_view name, std::string_view method, F func)
+{
+    if (only.empty() || only == name)
+    {
+        perf::print_timing(name, method, perf::time_calls(func));
+    }
+}
+
+void signed_integers()
+{
+    auto name = "signed-integers";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%i, %hi, %li, %lli\n", iv, sv, lv, llv); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%i, %hi, %li, %lli\n", iv, sv, lv, llv); });
+    run(name, "fmt::format", [] { return fmt::format("{}, {}, {}, {}\n", iv, sv, lv, llv).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{}, {}, {}, {}\n", iv, sv, lv, llv);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{}, {}, {}, {}\n", iv, sv, lv, llv);
+        fmt::print(devnull, "{}, {}, {}, {}\n", iv, sv, lv, llv);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{}, {}, {}, {}\n", iv, sv, lv, llv).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << iv << ", " << sv << ", " << lv << ", " << llv << "\n";
+        return written();
+    });
+}
+
+void unsigned_integers()
+{
+    auto name = "unsigned-integers";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%u, %hu, %lu, %llu\n", uiv, usv, ulv, ullv); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%u, %hu, %lu, %llu\n", uiv, usv, ulv, ullv); });
+    run(name, "fmt::format", [] { return fmt::format("{}, {}, {}, {}\n", uiv, usv, ulv, ullv).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{}, {}, {}, {}\n", uiv, usv, ulv, ullv);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{}, {}, {}, {}\n", uiv, usv, ulv, ullv);
+        fmt::print(devnull, "{}, {}, {}, {}\n", uiv, usv, ulv, ullv);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{}, {}, {}, {}\n", uiv, usv, ulv, ullv).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << uiv << ", " << usv << ", " << ulv << ", " << ullv << "\n";
+        return written();
+    });
+}
+
+// printf's %g and the stream default both use 6 significant digits, while {}
+// gives the shortest text that reads back as the same value.
+void floats()
+{
+    auto name = "floating-point";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%g %g %Lg\n", f, d, ld); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%g %g %Lg\n", f, d, ld); });
+    run(name, "fmt::format", [] { return fmt::format("{} {} {}\n", f, d, ld).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{} {} {}\n", f, d, ld);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{} {} {}\n", f, d, ld);
+        fmt::print(devnull, "{} {} {}\n", f, d, ld);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{} {} {}\n", f, d, ld).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << f << " " << d << " " << ld << "\n";
+        return written();
+    });
+}
+
+void characters()
+{
+    auto name = "characters";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%c %hhd\n", c, c); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%c %hhd\n", c, c); });
+    run(name, "fmt::format", [] { return fmt::format("{} {:d}\n", c, c).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{} {:d}\n", c, c);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{} {:d}\n", c, c);
+        fmt::print(devnull, "{} {:d}\n", c, c);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{} {:d}\n", c, c).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << c << " " << static_cast<int>(c) << "\n";
+        return written();
+    });
+}
+
+// printf can't take a string_view directly, but can print one with %.*s.
+void strings()
+{
+    auto name = "strings";
+    run(name, "snprintf", [] {
+        return snprintf(buf, sizeof(buf), "%s %s %.*s\n", cptr, str.c_str(),
+                        static_cast<int>(strview.size()), strview.data());
+    });
+    run(name, "fprintf", [] {
+        return fprintf(devnull, "%s %s %.*s\n", cptr, str.c_str(),
+                       static_cast<int>(strview.size()), strview.data());
+    });
+    run(name, "fmt::format", [] { return fmt::format("{} {} {}\n", cptr, str, strview).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{} {} {}\n", cptr, str, strview);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{} {} {}\n", cptr, str, strview);
+        fmt::print(devnull, "{} {} {}\n", cptr, str, strview);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{} {} {}\n", cptr, str, strview).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << cptr << " " << str << " " << strview << "\n";
+        return written();
+    });
+}
+
+void pointers()
+{
+    auto name = "pointers";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%p\n", static_cast<const void*>(cptr)); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%p\n", static_cast<const void*>(cptr)); });
+    run(name, "fmt::format", [] { return fmt::format("{}\n", static_cast<const void*>(cptr)).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{}\n", static_cast<const void*>(cptr));
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{}\n", static_cast<const void*>(cptr));
+        fmt::print(devnull, "{}\n", static_cast<const void*>(cptr));
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{}\n", static_cast<const void*>(cptr)).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << static_cast<const void*>(cptr) << "\n";
+        return written();
+    });
+}
+
+void alignment()
+{
+    auto name = "alignment";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "[%-10d] [%10d]\n", iv, iv); });
+    run(name, "fprintf", [] { return fprintf(devnull, "[%-10d] [%10d]\n", iv, iv); });
+    run(name, "fmt::format", [] { return fmt::format("[{:<10}] [{:>10}]\n", iv, iv).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "[{:<10}] [{:>10}]\n", iv, iv);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("[{:<10}] [{:>10}]\n", iv, iv);
+        fmt::print(devnull, "[{:<10}] [{:>10}]\n", iv, iv);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("[{:<10}] [{:>10}]\n", iv, iv).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << "[" << left << setw(10) << iv << "] [" << right << setw(10) << iv << "]\n";
+        return written();
+    });
+}
+
+// Streams have showpos for '+', but nothing like the ' ' sign option.
+void signs()
+{
+    auto name = "sign";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "[%+d] [% d] [%+d] [% d]\n", neg, neg, pos, pos); });
+    run(name, "fprintf", [] { return fprintf(devnull, "[%+d] [% d] [%+d] [% d]\n", neg, neg, pos, pos); });
+    run(name, "fmt::format", [] { return fmt::format("[{:+}] [{: }] [{:+}] [{: }]\n", neg, neg, pos, pos).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "[{:+}] [{: }] [{:+}] [{: }]\n", neg, neg, pos, pos);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("[{:+}] [{: }] [{:+}] [{: }]\n", neg, neg, pos, pos);
+        fmt::print(devnull, "[{:+}] [{: }] [{:+}] [{: }]\n", neg, neg, pos, pos);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("[{:+}] [{: }] [{:+}] [{: }]\n", neg, neg, pos, pos).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        auto& os = fresh();
+        os << "[" << showpos << neg << "] [" << noshowpos << (neg < 0 ? "" : " ") << neg;
+        os << "] [" << showpos << pos << "] [" << noshowpos << (pos < 0 ? "" : " ") << pos << "]\n";
+        return written();
+    });
+}
+
+void runtime_width()
+{
+    auto name = "runtime-width";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%*.*f\n", width, prec, val); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%*.*f\n", width, prec, val); });
+    run(name, "fmt::format", [] { return fmt::format("{:{}.{}f}\n", val, width, prec).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{:{}.{}f}\n", val, width, prec);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{:{}.{}f}\n", val, width, prec);
+        fmt::print(devnull, "{:{}.{}f}\n", val, width, prec);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{:{}.{}f}\n", val, width, prec).size(); });
+#endif
+    run(name, "ostringstream", [] {
+        fresh() << fixed << setw(width) << setprecision(prec) << val << "\n";
+        return written();
+    });
+}
+
+// Streams have no positional parameters.
+void positional()
+{
+    auto name = "positional";
+    run(name, "snprintf", [] { return snprintf(buf, sizeof(buf), "%1$*2$.*3$f\n", fv, width, prec); });
+    run(name, "fprintf", [] { return fprintf(devnull, "%1$*2$.*3$f\n", fv, width, prec); });
+    run(name, "fmt::format", [] { return fmt::format("{0:{1}.{2}f}\n", fv, width, prec).size(); });
+    run(name, "fmt::format_to", [] {
+        mbuf.clear();
+        fmt::format_to(back_inserter(mbuf), "{0:{1}.{2}f}\n", fv, width, prec);
+        return mbuf.size();
+    });
+    run(name, "fmt::print", [] {
+        static const auto n = fmt::formatted_size("{0:{1}.{2}f}\n", fv, width, prec);
+        fmt::print(devnull, "{0:{1}.{2}f}\n", fv, width, prec);
+        return n;
+    });
+#ifdef HAVE_STD_FORMAT
+    run(name, "std::format", [] { return std::format("{0:{1}.{2}f}\n", fv, width, prec).size(); });
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        only = argv[1];
+    }
+    devnull = fopen("/dev/null", "w");
+    if (!devnull)
+    {
+        cerr << "Can't open /dev/null\n";
+        return 1;
+    }
+
+    perf::print_header();
+    signed_integers();
+    unsigned_integers();
+    floats();
+    characters();
+    strings();
+    pointers();
+    alignment();
+    signs();
+    runtime_width();
+    positional();
+    fclose(devnull);
+}
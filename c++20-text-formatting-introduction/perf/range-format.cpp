@@ -0,0 +1,121 @@
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+#include "range-format.h"
+#include "timing.h"
+
+// Compares VecOut from code/format_to.cpp with fmt::join and rangefmt::join
+// from range-format.h, formatting a vector of a million ints with and without
+// a spec, a span of doubles and a map. VecOut puts a space after every
+// element, so a space is added to the end of the others before checking they
+// give the same text.
+
+using namespace std;
+using namespace fmt;
+
+string VecOut(const vector<int>& v)
+{
+    string retval;
+    back_insert_iterator<string> out(retval);
+    for (const auto& i: v)
+    {
+        out = format_to(out, "{} ", i);
+    }
+    return retval;
+}
+
+string VecOutWidth(const vector<int>& v)
+{
+    string retval;
+    back_insert_iterator<string> out(retval);
+    for (const auto& i: v)
+    {
+        out = format_to(out, "{:>6} ", i);
+    }
+    return retval;
+}
+
+bool ok = true;
+
+template<class F>
+void run(std::string_view name, std::string_view method, size_t elements, const string& expected, F func)
+{
+    if (func() != expected)
+    {
+        cerr << method << " gives different text for " << name << "\n";
+        ok = false;
+        return;
+    }
+    auto t = perf::time_calls([&] { return func().size(); });
+    print("{:<12} {:<16} {:>10.2f} {:>10.1f} {:>10.1f}\n", name, method, t.ns_per_call / 1e6,
+          elements / t.ns_per_call * 1e3, t.mb_per_sec());
+}
+
+int main()
+{
+    constexpr size_t count = 1'000'000;
+    vector<int> ints;
+    vector<double> doubles;
+    map<int, int> squares;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int v = static_cast<int>(i * 2654435761u % 200'000) - 100'000;
+        ints.push_back(v);
+        doubles.push_back(v / 7.0);
+        if (i < count / 10)
+        {
+            squares[v] = v % 1000 * (v % 1000);
+        }
+    }
+    span<const double> ds(doubles);
+
+    print("{:<12} {:<16} {:>10} {:>10} {:>10}\n", "case", "method", "ms/call", "Melem/s", "MB/s");
+
+    auto expected = VecOut(ints);
+    run("ints", "VecOut", count, expected, [&] { return VecOut(ints); });
+    run("ints", "fmt::join", count, expected, [&] { return format("{} ", fmt::join(ints, " ")); });
+    run("ints", "rangefmt::join", count, expected, [&] { return format("{} ", rangefmt::join(ints, " ")); });
+
+    expected = VecOutWidth(ints);
+    run("ints-width", "VecOut", count, expected, [&] { return VecOutWidth(ints); });
+    run("ints-width", "fmt::join", count, expected, [&] { return format("{:>6} ", fmt::join(ints, " ")); });
+    run("ints-width", "rangefmt::join", count, expected, [&] { return format("{:>6} ", rangefmt::join(ints, " ")); });
+
+    expected.clear();
+    for (auto d: ds)
+    {
+        format_to(back_inserter(expected), "{:.2f} ", d);
+    }
+    run("doubles", "format_to loop", count, expected, [&] {
+        string s;
+        for (auto d: ds)
+        {
+            format_to(back_inserter(s), "{:.2f} ", d);
+        }
+        return s;
+    });
+    run("doubles", "fmt::join", count, expected, [&] { return format("{:.2f} ", fmt::join(ds, " ")); });
+    run("doubles", "rangefmt::join", count, expected, [&] { return format("{:.2f} ", rangefmt::join(ds, " ")); });
+
+    expected.clear();
+    for (const auto& [k, v]: squares)
+    {
+        format_to(back_inserter(expected), "{}: {} ", k, v);
+    }
+    run("map", "format_to loop", squares.size(), expected, [&] {
+        string s;
+        for (const auto& [k, v]: squares)
+        {
+            format_to(back_inserter(s), "{}: {} ", k, v);
+        }
+        return s;
+    });
+    run("map", "rangefmt::join", squares.size(), expected, [&] { return format("{} ", rangefmt::join(squares, " ")); });
+
+    return ok ? 0 : 1;
+}
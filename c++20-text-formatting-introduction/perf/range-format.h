@@ -0,0 +1,166 @@
+// Formatting a whole container in one argument, in place of the VecOut
+// function in code/format_to.cpp.
+//
+//     fmt::format("{}", rangefmt::join(v, " "))
+//     fmt::format("{:>6}", rangefmt::join(v, " "))
+//     fmt::format("{:.2f}", rangefmt::join(m, ", ", ": "))
+//
+// The spec applies to every element, and is parsed once for the whole
+// container rather than once per element as VecOut's "{} " is. The
+// elements and separators are written straight into fmt's output buffer,
+// where VecOut pushes one character at a time through a
+// back_insert_iterator<string>. Integers with no spec, the common case, skip
+// the formatter altogether and are written with fmt::format_int.
+//
+// Any range that works with a range-based for can be used, e.g. a vector,
+// span, array or list. For maps, and other ranges of pairs, each element is
+// written as the key, the key separator and the value, and the spec applies
+// to the value.
+
+#ifndef PERF_RANGE_FORMAT_H
+#define PERF_RANGE_FORMAT_H
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace rangefmt
+{
+
+template<class Range>
+struct Joined
+{
+    const Range& range;
+    std::string_view sep;
+    std::string_view key_sep;
+};
+
+template<class Range>
+Joined<Range> join(const Range& range, std::string_view sep = ", ", std::string_view key_sep = ": ")
+{
+    return {range, sep, key_sep};
+}
+
+namespace detail
+{
+
+template<class T>
+struct is_pair : std::false_type {};
+
+template<class K, class V>
+struct is_pair<std::pair<K, V>> : std::true_type {};
+
+template<class T>
+using value_t = std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(std::declval<const T&>()))>>;
+
+template<class T, bool = is_pair<T>::value>
+struct element
+{
+    using type = T;
+};
+
+template<class T>
+struct element<T, true>
+{
+    using type = std::remove_cv_t<typename T::second_type>;
+};
+
+// Integers that format_int can write, leaving out bool and the char types,
+// which format as text.
+template<class T>
+constexpr bool is_plain_int_v = std::is_integral_v<T> && !std::is_same_v<T, bool>
+    && !std::is_same_v<T, char> && !std::is_same_v<T, signed char> && !std::is_same_v<T, unsigned char>
+    && !std::is_same_v<T, wchar_t> && !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>
+    && !std::is_same_v<T, char8_t>;
+
+template<class OutputIt>
+OutputIt write(std::string_view s, OutputIt out)
+{
+    return std::copy(s.begin(), s.end(), out);
+}
+
+// Write a value with the default format.
+template<class T, class OutputIt>
+OutputIt write_plain(const T& value, OutputIt out)
+{
+    if constexpr (is_plain_int_v<T>)
+    {
+        fmt::format_int s(value);
+        return write({s.data(), s.size()}, out);
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    {
+        return write(std::string_view(value), out);
+    }
+    else
+    {
+        return fmt::format_to(out, "{}", value);
+    }
+}
+
+} // namespace detail
+
+} // namespace rangefmt
+
+template<class Range>
+struct fmt::formatter<rangefmt::Joined<Range>>
+{
+    using value_type = rangefmt::detail::value_t<Range>;
+    using element_type = typename rangefmt::detail::element<value_type>::type;
+
+    constexpr auto parse(format_parse_context& ctx)
+    {
+        auto it = ctx.begin();
+        plain_ = it == ctx.end() || *it == '}';
+        return element_.parse(ctx);
+    }
+
+    template<class FormatContext>
+    auto format(const rangefmt::Joined<Range>& j, FormatContext& ctx) const
+    {
+        auto out = ctx.out();
+        bool first = true;
+        for (const auto& e: j.range)
+        {
+            if (!first)
+            {
+                out = rangefmt::detail::write(j.sep, out);
+            }
+            first = false;
+            if constexpr (rangefmt::detail::is_pair<value_type>::value)
+            {
+                out = rangefmt::detail::write_plain(e.first, out);
+                out = rangefmt::detail::write(j.key_sep, out);
+                out = write_element(e.second, out, ctx);
+            }
+            else
+            {
+                out = write_element(e, out, ctx);
+            }
+        }
+        return out;
+    }
+
+private:
+    template<class OutputIt, class FormatContext>
+    OutputIt write_element(const element_type& value, OutputIt out, FormatContext& ctx) const
+    {
+        if constexpr (rangefmt::detail::is_plain_int_v<element_type>)
+        {
+            if (plain_)
+            {
+                return rangefmt::detail::write_plain(value, out);
+            }
+        }
+        ctx.advance_to(out);
+        return element_.format(value, ctx);
+    }
+
+    fmt::formatter<element_type> element_;
+    bool plain_ = true;
+};
+
+#endif // PERF_RANGE_FORMAT_H
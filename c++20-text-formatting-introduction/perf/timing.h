@@ -0,0 +1,84 @@
+// Timing helpers for the benchmark programs in this directory.
+
+#ifndef PERF_TIMING_H
+#define PERF_TIMING_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include <fmt/format.h>
+#include <string_view>
+
+namespace perf
+{
+
+// Stop the compiler discarding a value it thinks is unused.
+template<class T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Timing
+{
+    double ns_per_call = 0;
+    double bytes_per_call = 0;
+
+    double mb_per_sec() const
+    {
+        return ns_per_call > 0 ? bytes_per_call / ns_per_call * 1e3 : 0;
+    }
+};
+
+// Call f repeatedly, doubling the number of calls until they take at least
+// min_ms milliseconds. f returns the number of bytes of output it produced.
+template<class F>
+Timing time_calls(F f, double min_ms = 100.0)
+{
+    using clock = std::chrono::steady_clock;
+    std::size_t calls = 1;
+    for (;;)
+    {
+        std::size_t bytes = 0;
+        auto begin = clock::now();
+        for (std::size_t i = 0; i < calls; ++i)
+        {
+            bytes += f();
+        }
+        std::chrono::duration<double, std::nano> elapsed = clock::now() - begin;
+        do_not_optimize(bytes);
+        if (elapsed.count() >= min_ms * 1e6)
+        {
+            return {elapsed.count() / calls, static_cast<double>(bytes) / calls};
+        }
+        calls *= 2;
+    }
+}
+
+inline void print_header()
+{
+    fmt::print("{:<24} {:<20} {:>10} {:>10}\n", "case", "method", "ns/call", "MB/s");
+}
+
+inline void print_timing(std::string_view name, std::string_view method, const Timing& t)
+{
+    fmt::print("{:<24} {:<20} {:>10.1f} {:>10.1f}\n", name, method, t.ns_per_call, t.mb_per_sec());
+}
+
+// The value below which the fraction p of the samples fall, or 0 if there
+// are none. The samples must be sorted.
+template<class T>
+T percentile(const std::vector<T>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return T{};
+    }
+    auto i = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+} // namespace perf
+
+#endif // PERF_TIMING_H
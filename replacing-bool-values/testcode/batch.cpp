@@ -0,0 +1,283 @@
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
+
+// The other programs pass flags to one function call at a time. Here we
+// process a large array of records, each holding three flags and the three
+// values the threeflag function would have read, to see whether packing the
+// flags into bits pays off when the same calculation is done millions of times.
+//
+// Every version returns the sum of the results for all the records, which is
+// checked against the plain scalar version before anything is timed. The sum
+// is unsigned so it can wrap without undefined behaviour.
+
+constexpr std::size_t record_count = 1 << 20;
+
+constexpr unsigned F1_True = 0x1;
+constexpr unsigned F2_True = 0x2;
+constexpr unsigned F3_True = 0x4;
+
+// Flags packed into the bits of a byte, with the values following it, so each
+// record fits in 32 bits.
+struct Record
+{
+    std::uint8_t flags;
+    std::uint8_t v1;
+    std::uint8_t v2;
+    std::uint8_t v3;
+};
+static_assert(sizeof(Record) == 4);
+
+// The same data with a bool for each flag.
+struct BoolRecord
+{
+    bool f1;
+    bool f2;
+    bool f3;
+    std::uint8_t v1;
+    std::uint8_t v2;
+    std::uint8_t v3;
+};
+
+// Structure of arrays layout, one array for each field.
+struct Records
+{
+    std::vector<std::uint8_t> flags;
+    std::vector<std::uint8_t> v1;
+    std::vector<std::uint8_t> v2;
+    std::vector<std::uint8_t> v3;
+};
+
+std::vector<Record> records;
+std::vector<BoolRecord> bool_records;
+Records soa_records;
+
+void make_records()
+{
+    inputs::XorShift32 gen(1);
+    records.resize(record_count);
+    for (auto& r: records)
+    {
+        r.flags = gen() % 8;
+        r.v1 = gen() % 64;
+        r.v2 = gen() % 64;
+        r.v3 = gen() % 64;
+    }
+
+    bool_records.clear();
+    soa_records = {};
+    for (const auto& r: records)
+    {
+        bool_records.push_back({(r.flags & F1_True) != 0, (r.flags & F2_True) != 0,
+                                (r.flags & F3_True) != 0, r.v1, r.v2, r.v3});
+        soa_records.flags.push_back(r.flags);
+        soa_records.v1.push_back(r.v1);
+        soa_records.v2.push_back(r.v2);
+        soa_records.v3.push_back(r.v3);
+    }
+}
+
+// The calculation from threeflag, one record at a time using the ternary
+// operator.
+std::uint32_t scalar(const std::vector<Record>& recs)
+{
+    std::uint32_t sum = 0;
+    for (const auto& r: recs)
+    {
+        int v = (r.flags & F1_True) ? r.v1 : -r.v1;
+        v = (r.flags & F2_True) ? (v + r.v2) : (v - r.v2);
+        v = (r.flags & F3_True) ? (v * r.v3) : (v * 2 * r.v3);
+        sum += v;
+    }
+    return sum;
+}
+
+std::uint32_t scalar_bools(const std::vector<BoolRecord>& recs)
+{
+    std::uint32_t sum = 0;
+    for (const auto& r: recs)
+    {
+        int v = r.f1 ? r.v1 : -r.v1;
+        v = r.f2 ? (v + r.v2) : (v - r.v2);
+        v = r.f3 ? (v * r.v3) : (v * 2 * r.v3);
+        sum += v;
+    }
+    return sum;
+}
+
+// Turn each flag into a mask instead of testing it. A mask m of 0 or -1
+// negates x when it is -1 using (x ^ m) - m, and the second multiplier is
+// chosen by shifting v3 left by one when the third flag is clear.
+inline int branchless(unsigned flags, int v1, int v2, int v3)
+{
+    int m1 = static_cast<int>(flags & F1_True) - 1;
+    int m2 = static_cast<int>((flags >> 1) & 1) - 1;
+    int shift = 1 - static_cast<int>((flags >> 2) & 1);
+    int v = (v1 ^ m1) - m1;
+    v += (v2 ^ m2) - m2;
+    return v * (v3 << shift);
+}
+
+std::uint32_t masks(const std::vector<Record>& recs)
+{
+    std::uint32_t sum = 0;
+    for (const auto& r: recs)
+    {
+        sum += branchless(r.flags, r.v1, r.v2, r.v3);
+    }
+    return sum;
+}
+
+std::uint32_t soa(const Records& recs)
+{
+    std::uint32_t sum = 0;
+    auto n = recs.flags.size();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        sum += branchless(recs.flags[i], recs.v1[i], recs.v2[i], recs.v3[i]);
+    }
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// The SIMD versions are only built for x86, and only run if the CPU has the
+// instructions. Elsewhere the branchless and SoA versions above are the
+// fastest there are.
+//
+// Each 32-bit lane holds one whole Record, so the fields are pulled out with
+// shifts and masks, the flag bits are turned into all-ones/all-zeros lane
+// masks, and the two possible results are chosen with a blend.
+__attribute__((target("sse4.1")))
+std::uint32_t sse4(const std::vector<Record>& recs)
+{
+    const __m128i byte = _mm_set1_epi32(0xff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+
+    auto data = reinterpret_cast<const __m128i*>(recs.data());
+    std::size_t n = recs.size() / 4;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        __m128i r = _mm_loadu_si128(data + i);
+        __m128i flags = _mm_and_si128(r, byte);
+        __m128i v1 = _mm_and_si128(_mm_srli_epi32(r, 8), byte);
+        __m128i v2 = _mm_and_si128(_mm_srli_epi32(r, 16), byte);
+        __m128i v3 = _mm_srli_epi32(r, 24);
+
+        __m128i m1 = _mm_cmpeq_epi32(_mm_and_si128(flags, _mm_set1_epi32(F1_True)), zero);
+        __m128i m2 = _mm_cmpeq_epi32(_mm_and_si128(flags, _mm_set1_epi32(F2_True)), zero);
+        __m128i m3 = _mm_cmpeq_epi32(_mm_and_si128(flags, _mm_set1_epi32(F3_True)), zero);
+
+        __m128i v = _mm_sub_epi32(_mm_xor_si128(v1, m1), m1);
+        v = _mm_add_epi32(v, _mm_sub_epi32(_mm_xor_si128(v2, m2), m2));
+        __m128i mul = _mm_blendv_epi8(v3, _mm_add_epi32(v3, v3), m3);
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(v, mul));
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    std::uint32_t total = _mm_cvtsi128_si32(sum);
+    for (std::size_t i = n * 4; i < recs.size(); ++i)
+    {
+        total += branchless(recs[i].flags, recs[i].v1, recs[i].v2, recs[i].v3);
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+std::uint32_t avx2(const std::vector<Record>& recs)
+{
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+
+    auto data = reinterpret_cast<const __m256i*>(recs.data());
+    std::size_t n = recs.size() / 8;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        __m256i r = _mm256_loadu_si256(data + i);
+        __m256i flags = _mm256_and_si256(r, byte);
+        __m256i v1 = _mm256_and_si256(_mm256_srli_epi32(r, 8), byte);
+        __m256i v2 = _mm256_and_si256(_mm256_srli_epi32(r, 16), byte);
+        __m256i v3 = _mm256_srli_epi32(r, 24);
+
+        __m256i m1 = _mm256_cmpeq_epi32(_mm256_and_si256(flags, _mm256_set1_epi32(F1_True)), zero);
+        __m256i m2 = _mm256_cmpeq_epi32(_mm256_and_si256(flags, _mm256_set1_epi32(F2_True)), zero);
+        __m256i m3 = _mm256_cmpeq_epi32(_mm256_and_si256(flags, _mm256_set1_epi32(F3_True)), zero);
+
+        __m256i v = _mm256_sub_epi32(_mm256_xor_si256(v1, m1), m1);
+        v = _mm256_add_epi32(v, _mm256_sub_epi32(_mm256_xor_si256(v2, m2), m2));
+        __m256i mul = _mm256_blendv_epi8(v3, _mm256_add_epi32(v3, v3), m3);
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(v, mul));
+    }
+
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    std::uint32_t total = _mm_cvtsi128_si32(half);
+    for (std::size_t i = n * 8; i < recs.size(); ++i)
+    {
+        total += branchless(recs[i].flags, recs[i].v1, recs[i].v2, recs[i].v3);
+    }
+    return total;
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+    make_records();
+
+    std::uint32_t v = scalar(records);
+    bool ok = true;
+    auto check = [&](const char* name, std::uint32_t result) {
+        if (result != v)
+        {
+            std::cerr << fmt::format("{} gave {}, expected {}\n", name, result, v);
+            ok = false;
+        }
+    };
+
+    check("batch-bools", scalar_bools(bool_records));
+    check("batch-masks", masks(records));
+    check("batch-soa", soa(soa_records));
+#if defined(__x86_64__) || defined(__i386__)
+    bool have_sse4 = __builtin_cpu_supports("sse4.1");
+    bool have_avx2 = __builtin_cpu_supports("avx2");
+    if (have_sse4)
+    {
+        check("batch-sse4", sse4(records));
+    }
+    if (have_avx2)
+    {
+        check("batch-avx2", avx2(records));
+    }
+#endif
+    if (!ok)
+    {
+        return 1;
+    }
+
+    bench::add("batch-scalar", record_count, [] { return scalar(records); });
+    bench::add("batch-bools", record_count, [] { return scalar_bools(bool_records); });
+    bench::add("batch-masks", record_count, [] { return masks(records); });
+    bench::add("batch-soa", record_count, [] { return soa(soa_records); });
+#if defined(__x86_64__) || defined(__i386__)
+    if (have_sse4)
+    {
+        bench::add("batch-sse4", record_count, [] { return sse4(records); });
+    }
+    if (have_avx2)
+    {
+        bench::add("batch-avx2", record_count, [] { return avx2(records); });
+    }
+#endif
+    return bench::run(argc, argv, fmt::format("v={} - batch", v));
+}
@@ -0,0 +1,681 @@
+// A small microbenchmark harness shared by the flag passing test programs.
+//
+// Each program registers the code it wants timed with bench::add() and then
+// calls bench::run() from main. For each registered case the harness runs a
+// warmup, then keeps increasing the iteration count until a single timed run
+// takes at least the target time, and reports the time per operation in
+// nanoseconds. This gets us away from timing a fixed 1000 iteration loop with
+// std::clock, which mostly measured the granularity of the clock.
+//
+// The timed run can be repeated any number of times within the one process,
+// in which case the report gives the median, MAD, percentiles and a confidence
+// interval for the median (see statistics.h) instead of a single figure.
+//
+// With --perf the hardware performance counters (see perf_counters.h) are
+// read around every timed run and reported per op, so we can see whether two
+// versions differ in the number of instructions or in branch prediction.
+//
+// With --threads each case is also run on several threads at once, each
+// pinned to its own CPU where possible, to show the effect of any shared
+// state. Each thread runs the same number of iterations, and the ns/op figure
+// is the time for the slowest thread divided by the ops each thread did, so
+// with perfect scaling it stays the same as for one thread. The cases' code
+// must be safe to run on several threads; the positions in the inputs.h
+// buffers are thread_local for this reason. The counters from --perf only
+// cover the main thread, so they are not collected for these runs.
+//
+// Command line options understood by bench::run():
+//
+//   --min-time=MS     target time in milliseconds for a timed run (200)
+//   --warmup=MS       time in milliseconds to run before timing (50)
+//   --clock=steady    time using std::chrono::steady_clock (default)
+//   --clock=tsc       time using the CPU timestamp counter (x86 only)
+//   --filter=TEXT     only run cases whose name contains TEXT
+//   --repetitions=N   number of timed runs of each case (1)
+//   --outliers=K      reject runs more than K MADs from the median (3, 0=off)
+//   --format=text     report format: text (default), csv or json
+//   --perf            count cycles, instructions and branch misses per op
+//   --threads=N       run each case on 1, 2, 4 ... N threads at once (all for
+//                     every CPU), reporting throughput and scaling efficiency
+//   --list            list the registered cases and exit
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <fmt/format.h>
+#include "perf_counters.h"
+#include "statistics.h"
+
+namespace bench
+{
+
+// Stop the compiler from discarding a value, or assuming it knows what the
+// value is, without adding any instructions to the timed code.
+template<class T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template<class T>
+inline void do_not_optimize(T& value)
+{
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+// Force any pending writes to memory to be done before this point.
+inline void clobber_memory()
+{
+    asm volatile("" : : : "memory");
+}
+
+enum class ClockKind { Steady, Tsc };
+
+enum class Format { Text, Csv, Json };
+
+struct Options
+{
+    double min_time_ms = 200.0;
+    double warmup_ms = 50.0;
+    ClockKind clock = ClockKind::Steady;
+    std::string filter;
+    bool list = false;
+    int repetitions = 1;
+    double outlier_limit = 3.0;
+    Format format = Format::Text;
+    bool perf = false;
+    int threads = 0;            // 0 for single threaded runs only
+    std::string check;          // program's check value, e.g. "v=-6453"
+};
+
+// Extra named figures describing a case, such as the size of the type being
+// passed, that are included in its report.
+using Info = std::vector<std::pair<std::string, double>>;
+
+struct Case
+{
+    std::string name;
+    unsigned ops_per_iteration;
+    std::function<void(std::uint64_t)> body;
+    Info info;
+};
+
+struct Result
+{
+    std::string name;
+    std::uint64_t iterations;
+    Info info;
+    std::vector<double> samples;    // ns/op for each repetition
+    Summary stats;
+    bool have_counters = false;
+    CounterValues counters;         // totals over all the repetitions
+    double counted_ops = 0;         // number of ops the counters cover
+
+    double per_op(std::uint64_t total) const
+    {
+        return counted_ops > 0 ? total / counted_ops : 0.0;
+    }
+};
+
+inline std::vector<Case>& registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+// Register a case whose body runs the given number of iterations itself.
+// Returns the case so its info can be filled in.
+inline Case& add_batch(std::string name, unsigned ops_per_iteration,
+                       std::function<void(std::uint64_t)> body)
+{
+    registry().push_back({std::move(name), ops_per_iteration, std::move(body), {}});
+    return registry().back();
+}
+
+// Register a case that calls f once per iteration. The value returned by f
+// is passed to do_not_optimize so the calls cannot be removed.
+template<class F>
+Case& add(std::string name, unsigned ops_per_iteration, F f)
+{
+    return add_batch(std::move(name), ops_per_iteration, [f](std::uint64_t iterations) {
+        for (std::uint64_t i = 0; i < iterations; ++i)
+        {
+            auto r = f();
+            do_not_optimize(r);
+        }
+    });
+}
+
+inline std::uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Work out how many timestamp counter ticks there are per nanosecond by
+// comparing it against steady_clock over a short sleep.
+inline double tsc_ticks_per_ns()
+{
+    static const double ticks = [] {
+        auto begin = std::chrono::steady_clock::now();
+        auto tbegin = read_tsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto tend = read_tsc();
+        auto end = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::nano> ns = end - begin;
+        return static_cast<double>(tend - tbegin) / ns.count();
+    }();
+    return ticks;
+}
+
+// Time one call of the case body for the given number of iterations.
+inline double time_ns(const Case& c, std::uint64_t iterations, ClockKind clock)
+{
+    if (clock == ClockKind::Tsc)
+    {
+        clobber_memory();
+        auto begin = read_tsc();
+        c.body(iterations);
+        clobber_memory();
+        auto end = read_tsc();
+        return static_cast<double>(end - begin) / tsc_ticks_per_ns();
+    }
+
+    clobber_memory();
+    auto begin = std::chrono::steady_clock::now();
+    c.body(iterations);
+    clobber_memory();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+// Find an iteration count that makes a run take at least target_ns. The
+// count grows by at most a factor of 10 each step so a run that was too fast
+// to time accurately doesn't make us overshoot wildly.
+inline std::uint64_t scale_iterations(const Case& c, double target_ns, ClockKind clock,
+                                      double& elapsed)
+{
+    std::uint64_t iterations = 1;
+    for (;;)
+    {
+        elapsed = time_ns(c, iterations, clock);
+        if (elapsed >= target_ns)
+        {
+            return iterations;
+        }
+        double factor = elapsed > 0 ? 1.4 * target_ns / elapsed : 10.0;
+        if (factor > 10.0)
+        {
+            factor = 10.0;
+        }
+        auto next = static_cast<std::uint64_t>(iterations * factor);
+        iterations = next > iterations ? next : iterations + 1;
+    }
+}
+
+// The iteration count is only worked out once, so every repetition does the
+// same amount of work and the samples can be compared directly.
+// If counters is not null each repetition is timed again with the counters
+// running, so the cost of starting and stopping them doesn't affect the first
+// sample.
+inline Result run_case(const Case& c, const Options& opts, PerfCounters* counters)
+{
+    double elapsed = 0;
+    scale_iterations(c, opts.warmup_ms * 1e6, opts.clock, elapsed);
+    auto iterations = scale_iterations(c, opts.min_time_ms * 1e6, opts.clock, elapsed);
+    double ops = static_cast<double>(iterations) * c.ops_per_iteration;
+
+    Result r;
+    r.name = c.name;
+    r.iterations = iterations;
+    r.info = c.info;
+    r.samples.push_back(elapsed / ops);
+    for (int i = 1; i < opts.repetitions; ++i)
+    {
+        r.samples.push_back(time_ns(c, iterations, opts.clock) / ops);
+    }
+    r.stats = summarise(r.samples, opts.outlier_limit);
+
+    if (counters && counters->available())
+    {
+        r.have_counters = true;
+        for (int i = 0; i < opts.repetitions; ++i)
+        {
+            counters->start();
+            c.body(iterations);
+            r.counters += counters->stop();
+            r.counted_ops += ops;
+        }
+    }
+    return r;
+}
+
+// Pin the calling thread to the index'th CPU it is allowed to run on,
+// wrapping round if there are more threads than CPUs.
+inline void pin_thread(int index)
+{
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return;
+    }
+    int count = CPU_COUNT(&allowed);
+    int wanted = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed) && wanted-- == 0)
+        {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+            return;
+        }
+    }
+#else
+    (void)index;
+#endif
+}
+
+// Each thread writes its time to its own cache line, so the threads don't
+// slow each other down by sharing one.
+struct alignas(64) ThreadTime
+{
+    double ns = 0;
+};
+
+// Run the case body on the given number of threads at once and return the
+// time taken by the slowest. The threads wait until they have all started
+// before any of them begins.
+inline double time_threads_ns(const Case& c, std::uint64_t iterations, int threads,
+                              ClockKind clock)
+{
+    std::vector<ThreadTime> times(threads);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+    {
+        pool.emplace_back([&, t] {
+            pin_thread(t);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            times[t].ns = time_ns(c, iterations, clock);
+        });
+    }
+    while (ready.load() < threads)
+    {
+        std::this_thread::yield();
+    }
+    go.store(true, std::memory_order_release);
+    for (auto& t: pool)
+    {
+        t.join();
+    }
+
+    double slowest = 0;
+    for (const auto& t: times)
+    {
+        slowest = std::max(slowest, t.ns);
+    }
+    return slowest;
+}
+
+// The thread counts to try: powers of two up to, and then including, max.
+inline std::vector<int> thread_counts(int max)
+{
+    std::vector<int> counts;
+    for (int n = 1; n < max; n *= 2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(max);
+    return counts;
+}
+
+// Run a case on each number of threads from thread_counts(). Each result is
+// named "case/threads:N" and its info gives the thread count, the total
+// throughput in millions of ops per second, and the scaling efficiency: the
+// one thread ns/op divided by the N thread ns/op.
+inline std::vector<Result> run_case_threads(const Case& c, const Options& opts)
+{
+    double elapsed = 0;
+    scale_iterations(c, opts.warmup_ms * 1e6, opts.clock, elapsed);
+    auto iterations = scale_iterations(c, opts.min_time_ms * 1e6, opts.clock, elapsed);
+    double ops = static_cast<double>(iterations) * c.ops_per_iteration;
+
+    std::vector<Result> results;
+    double single = 0;
+    for (int n: thread_counts(opts.threads))
+    {
+        Result r;
+        r.name = fmt::format("{}/threads:{}", c.name, n);
+        r.iterations = iterations;
+        r.info = c.info;
+        for (int i = 0; i < opts.repetitions; ++i)
+        {
+            r.samples.push_back(time_threads_ns(c, iterations, n, opts.clock) / ops);
+        }
+        r.stats = summarise(r.samples, opts.outlier_limit);
+        if (n == 1)
+        {
+            single = r.stats.median;
+        }
+        r.info.push_back({"threads", n});
+        r.info.push_back({"mops", n * 1e3 / r.stats.median});
+        r.info.push_back({"efficiency", single / r.stats.median});
+        results.push_back(std::move(r));
+    }
+    return results;
+}
+
+inline bool parse_option(std::string_view arg, std::string_view name, std::string_view& value)
+{
+    if (arg.substr(0, name.size()) != name)
+    {
+        return false;
+    }
+    value = arg.substr(name.size());
+    return true;
+}
+
+inline Options parse_options(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg(argv[i]);
+        std::string_view value;
+        if (parse_option(arg, "--min-time=", value))
+        {
+            opts.min_time_ms = std::stod(std::string(value));
+        }
+        else if (parse_option(arg, "--warmup=", value))
+        {
+            opts.warmup_ms = std::stod(std::string(value));
+        }
+        else if (parse_option(arg, "--clock=", value))
+        {
+            opts.clock = value == "tsc" ? ClockKind::Tsc : ClockKind::Steady;
+        }
+        else if (parse_option(arg, "--filter=", value))
+        {
+            opts.filter = value;
+        }
+        else if (parse_option(arg, "--repetitions=", value))
+        {
+            opts.repetitions = std::max(1, std::stoi(std::string(value)));
+        }
+        else if (parse_option(arg, "--outliers=", value))
+        {
+            opts.outlier_limit = std::stod(std::string(value));
+        }
+        else if (parse_option(arg, "--format=", value))
+        {
+            opts.format = value == "csv" ? Format::Csv
+                        : value == "json" ? Format::Json
+                        : Format::Text;
+        }
+        else if (parse_option(arg, "--threads=", value))
+        {
+            opts.threads = value == "all"
+                         ? static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))
+                         : std::max(1, std::stoi(std::string(value)));
+        }
+        else if (arg == "--perf")
+        {
+            opts.perf = true;
+        }
+        else if (arg == "--list")
+        {
+            opts.list = true;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+        }
+    }
+    return opts;
+}
+
+// The names of all the info figures of the registered cases, in the order
+// they are first seen, for the CSV columns.
+inline std::vector<std::string> info_columns(const Options& opts)
+{
+    std::vector<std::string> names;
+    if (opts.threads > 0)
+    {
+        names = {"threads", "mops", "efficiency"};
+    }
+    for (const auto& c: registry())
+    {
+        for (const auto& i: c.info)
+        {
+            if (std::find(names.begin(), names.end(), i.first) == names.end())
+            {
+                names.push_back(i.first);
+            }
+        }
+    }
+    return names;
+}
+
+inline void report_header(const Options& opts)
+{
+    switch (opts.format)
+    {
+    case Format::Text:
+        if (!opts.check.empty())
+        {
+            std::cout << opts.check << "\n";
+        }
+        break;
+    case Format::Csv:
+        std::cout << "check,name,iterations,repetitions,outliers,median,mad,min,max,mean,"
+                     "p5,p95,ci_low,ci_high";
+        if (opts.perf)
+        {
+            std::cout << ",cycles,instructions,branch_misses,ipc";
+        }
+        for (const auto& name: info_columns(opts))
+        {
+            std::cout << "," << name;
+        }
+        std::cout << "\n";
+        break;
+    case Format::Json:
+        std::cout << fmt::format("{{\"check\": \"{}\", \"results\": [", opts.check);
+        break;
+    }
+}
+
+inline void report(const Result& r, const Options& opts, bool first)
+{
+    const auto& s = r.stats;
+    switch (opts.format)
+    {
+    case Format::Text:
+        if (s.count == 1)
+        {
+            std::cout << fmt::format("{:<24} {:>12} iterations {:>10.3f} ns/op\n",
+                                     r.name, r.iterations, s.median);
+        }
+        else
+        {
+            std::cout << fmt::format("{:<24} {:>12} iterations {:>10.3f} ns/op"
+                                     " (MAD {:.3f}, min {:.3f}, p5-p95 {:.3f}-{:.3f},"
+                                     " 95% CI {:.3f}-{:.3f}, {}/{} outliers)\n",
+                                     r.name, r.iterations, s.median, s.mad, s.min,
+                                     s.p5, s.p95, s.ci_low, s.ci_high, s.outliers, s.count);
+        }
+        if (r.have_counters)
+        {
+            std::cout << fmt::format("{:<24} {:>10.2f} cycles/op {:>10.2f} instructions/op"
+                                     " {:>8.3f} branch-misses/op {:>6.2f} IPC\n",
+                                     "", r.per_op(r.counters.cycles),
+                                     r.per_op(r.counters.instructions),
+                                     r.per_op(r.counters.branch_misses), r.counters.ipc());
+        }
+        if (!r.info.empty())
+        {
+            std::cout << fmt::format("{:<24}", "");
+            for (const auto& i: r.info)
+            {
+                std::cout << fmt::format(" {}={:.6g}", i.first, i.second);
+            }
+            std::cout << "\n";
+        }
+        break;
+    case Format::Csv:
+        std::cout << fmt::format("{},{},{},{},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},"
+                                 "{:.4f},{:.4f},{:.4f},{:.4f}",
+                                 opts.check, r.name, r.iterations, s.count, s.outliers, s.median,
+                                 s.mad, s.min, s.max, s.mean, s.p5, s.p95,
+                                 s.ci_low, s.ci_high);
+        if (r.have_counters)
+        {
+            std::cout << fmt::format(",{:.4f},{:.4f},{:.4f},{:.4f}",
+                                     r.per_op(r.counters.cycles),
+                                     r.per_op(r.counters.instructions),
+                                     r.per_op(r.counters.branch_misses), r.counters.ipc());
+        }
+        else if (opts.perf)
+        {
+            std::cout << ",,,,";
+        }
+        for (const auto& name: info_columns(opts))
+        {
+            std::cout << ",";
+            for (const auto& i: r.info)
+            {
+                if (i.first == name)
+                {
+                    std::cout << fmt::format("{:.6g}", i.second);
+                }
+            }
+        }
+        std::cout << "\n";
+        break;
+    case Format::Json:
+        std::cout << fmt::format("{}\n  {{\"name\": \"{}\", \"iterations\": {}, "
+                                 "\"repetitions\": {}, \"outliers\": {}, "
+                                 "\"median\": {:.4f}, \"mad\": {:.4f}, "
+                                 "\"min\": {:.4f}, \"max\": {:.4f}, \"mean\": {:.4f}, "
+                                 "\"p5\": {:.4f}, \"p95\": {:.4f}, "
+                                 "\"ci_low\": {:.4f}, \"ci_high\": {:.4f}",
+                                 first ? "" : ",", r.name, r.iterations, s.count,
+                                 s.outliers, s.median, s.mad, s.min, s.max, s.mean,
+                                 s.p5, s.p95, s.ci_low, s.ci_high);
+        if (r.have_counters)
+        {
+            std::cout << fmt::format(", \"cycles\": {:.4f}, \"instructions\": {:.4f}, "
+                                     "\"branch_misses\": {:.4f}, \"ipc\": {:.4f}",
+                                     r.per_op(r.counters.cycles),
+                                     r.per_op(r.counters.instructions),
+                                     r.per_op(r.counters.branch_misses), r.counters.ipc());
+        }
+        for (const auto& i: r.info)
+        {
+            std::cout << fmt::format(", \"{}\": {:.6g}", i.first, i.second);
+        }
+        std::cout << "}";
+        break;
+    }
+}
+
+inline void report_footer(const Options& opts)
+{
+    if (opts.format == Format::Json)
+    {
+        std::cout << "\n]}\n";
+    }
+}
+
+// Run all the registered cases, printing the report for each to cout.
+inline std::vector<Result> run(const Options& opts)
+{
+    std::vector<Result> results;
+    std::unique_ptr<PerfCounters> counters;
+    if (opts.perf && !opts.list && opts.threads == 0)
+    {
+        counters = std::make_unique<PerfCounters>();
+        if (!counters->available())
+        {
+            std::cerr << "Performance counters not available: " << counters->error() << "\n";
+        }
+    }
+    if (!opts.list)
+    {
+        report_header(opts);
+    }
+    for (const auto& c: registry())
+    {
+        if (!opts.filter.empty() && c.name.find(opts.filter) == std::string::npos)
+        {
+            continue;
+        }
+        if (opts.list)
+        {
+            std::cout << c.name << "\n";
+            continue;
+        }
+        if (opts.threads > 0)
+        {
+            for (auto& r: run_case_threads(c, opts))
+            {
+                report(r, opts, results.empty());
+                results.push_back(std::move(r));
+            }
+            continue;
+        }
+        auto r = run_case(c, opts, counters.get());
+        report(r, opts, results.empty());
+        results.push_back(std::move(r));
+    }
+    if (!opts.list)
+    {
+        report_footer(opts);
+    }
+    return results;
+}
+
+// The check string is included in the report so the output of programs that
+// are meant to do the same work can be compared.
+inline int run(int argc, char* argv[], std::string check = {})
+{
+    auto opts = parse_options(argc, argv);
+    opts.check = std::move(check);
+    run(opts);
+    return 0;
+}
+
+} // namespace bench
+
+#endif // BENCHMARK_H
@@ -1,8 +1,8 @@
-#include <cstdlib>
 #include <iostream>
 #include <bitset>
-#include <ctime>
 #include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
 
 using bitset1 = std::bitset<1>;
 using bitset2 = std::bitset<2>;
@@ -17,14 +17,14 @@ constexpr bitset3 B3F3_True = 0x4;
 
 int oneflag(bitset1 f)
 {
-    int v = rand() % 64;
+    int v = inputs::next_value();
     return (f & B1F1_True) == B1F1_True ? v : -v;
 }
 
 int twoflag(bitset2 f)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
     int v = (f & B2F1_True) == B2F1_True ? v1 : -v1;
     v = (f & B2F2_True) == B2F2_True ? (v + v2) : (v - v2);
     return v;
@@ -32,45 +32,62 @@ int twoflag(bitset2 f)
 
 int threeflag(bitset3 f)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
-    int v3 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
+    int v3 = inputs::next_value();
     int v = (f & B3F1_True) == B3F1_True ? v1 : -v1;
     v = (f & B3F2_True) == B3F2_True ? (v + v2) : (v - v2);
     v = (f & B3F3_True) == B3F3_True ? (v * v3) : (v * 2 * v3);
     return v;
 }
 
-int main()
+int allflags()
 {
-    std::srand(1);
     int v = 0;
 
-    auto begin = std::clock();
+    v += oneflag(0);
+    v += oneflag(B1F1_True);
 
-    for (int i = 0; i < 1'000; ++i)
-    {
-        v += oneflag(0);
-        v += oneflag(B1F1_True);
+    v += twoflag(0);
+    v += twoflag(B2F2_True);
+    v += twoflag(B2F1_True);
+    v += twoflag(B2F1_True | B2F2_True);
 
-        v += twoflag(0);
-        v += twoflag(B2F2_True);
-        v += twoflag(B2F1_True);
-        v += twoflag(B2F1_True | B2F2_True);
+    v += threeflag(0);
+    v += threeflag(B3F3_True);
+    v += threeflag(B3F2_True);
+    v += threeflag(B3F2_True | B3F3_True);
+    v += threeflag(B3F1_True);
+    v += threeflag(B3F1_True | B3F3_True);
+    v += threeflag(B3F1_True | B3F2_True);
+    v += threeflag(B3F1_True | B3F2_True | B3F3_True);
 
-        v += threeflag(0);
-        v += threeflag(B3F3_True);
-        v += threeflag(B3F2_True);
-        v += threeflag(B3F2_True | B3F3_True);
-        v += threeflag(B3F1_True);
-        v += threeflag(B3F1_True | B3F3_True);
-        v += threeflag(B3F1_True | B3F2_True);
-        v += threeflag(B3F1_True | B3F2_True | B3F3_True);
-    }
+    return v;
+}
+
+// Call each function once with the flags given by the bits of c.
+int randomflags(unsigned c)
+{
+    int v = oneflag(c);
+    v += twoflag(c);
+    v += threeflag(c);
+
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::reset();
+    int v = 0;
+    int r = 0;
 
-    auto end = std::clock();
-    auto time = 1000000.0 * (end - begin)/CLOCKS_PER_SEC;
+    for (int i = 0; i < 1'000; ++i)
+    {
+        v += allflags();
+        r += randomflags(inputs::next_flags());
+    }
 
-    std::clog << fmt::format("{}\n", time);
-    std::cout << fmt::format("v={} : Time={} us - bitset-consts\n", v, time);
+    bench::add("bitset-consts", 14, allflags);
+    bench::add("bitset-consts-random", 3, [] { return randomflags(inputs::next_flags()); });
+    return bench::run(argc, argv, fmt::format("v={} r={} - bitset-consts", v, r));
 }
@@ -1,18 +1,18 @@
-#include <cstdlib>
 #include <iostream>
-#include <ctime>
 #include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
 
 int oneflag(bool f)
 {
-    int v1 = rand() % 64;
+    int v1 = inputs::next_value();
     return f ? v1 : -v1;
 }
 
 int twoflag(bool f1, bool f2)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
     int v = f1 ? v1 : -v1;
     v = f2 ? (v + v2) : (v - v2);
     return v;
@@ -20,45 +20,62 @@ int twoflag(bool f1, bool f2)
 
 int threeflag(bool f1, bool f2, bool f3)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
-    int v3 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
+    int v3 = inputs::next_value();
     int v = f1 ? v1 : -v1;
     v = f2 ? (v + v2) : (v - v2);
     v = f3 ? (v * v3) : (v * 2 * v3);
     return v;
 }
 
-int main()
+int allflags()
 {
-    std::srand(1);
     int v = 0;
 
-    auto begin = std::clock();
+    v += oneflag(false);
+    v += oneflag(true);
 
-    for (int i = 0; i < 1'000; ++i)
-    {
-        v += oneflag(false);
-        v += oneflag(true);
+    v += twoflag(false, false);
+    v += twoflag(false, true);
+    v += twoflag(true, false);
+    v += twoflag(true, true);
 
-        v += twoflag(false, false);
-        v += twoflag(false, true);
-        v += twoflag(true, false);
-        v += twoflag(true, true);
+    v += threeflag(false, false, false);
+    v += threeflag(false, false, true);
+    v += threeflag(false, true, false);
+    v += threeflag(false, true, true);
+    v += threeflag(true, false, false);
+    v += threeflag(true, false, true);
+    v += threeflag(true, true, false);
+    v += threeflag(true, true, true);
 
-        v += threeflag(false, false, false);
-        v += threeflag(false, false, true);
-        v += threeflag(false, true, false);
-        v += threeflag(false, true, true);
-        v += threeflag(true, false, false);
-        v += threeflag(true, false, true);
-        v += threeflag(true, true, false);
-        v += threeflag(true, true, true);
-    }
+    return v;
+}
+
+// Call each function once with the flags given by the bits of c.
+int randomflags(unsigned c)
+{
+    int v = oneflag(c & 1);
+    v += twoflag(c & 1, c & 2);
+    v += threeflag(c & 1, c & 2, c & 4);
+
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::reset();
+    int v = 0;
+    int r = 0;
 
-    auto end = std::clock();
-    auto time = 1000000.0 * (end - begin)/CLOCKS_PER_SEC;
+    for (int i = 0; i < 1'000; ++i)
+    {
+        v += allflags();
+        r += randomflags(inputs::next_flags());
+    }
 
-    std::clog << fmt::format("{}\n", time);
-    std::cout << fmt::format("v={} : Time={} us - bools\n", v, time);
+    bench::add("bools", 14, allflags);
+    bench::add("bools-random", 3, [] { return randomflags(inputs::next_flags()); });
+    return bench::run(argc, argv, fmt::format("v={} r={} - bools", v, r));
 }
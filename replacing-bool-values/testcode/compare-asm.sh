@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Compare the -O3 assembler generated for the flag functions in two programs,
+# e.g. ./compare-asm.sh ints flagset
+#
+# The body of each function is taken from its label up to the .size
+# directive. Symbol names differ because the parameter types are part of the
+# mangled name, and local label numbers depend on what else is in the file,
+# so both are replaced with placeholders before comparing.
+
+if [ $# -ne 2 ]
+then
+    echo "Usage: $0 program1 program2"
+    exit 2
+fi
+
+make -s $1.out $2.out
+
+function body
+{
+    awk -v fn="$2" '
+        $0 ~ "^_Z[0-9]+" fn "[^:]*:$" { inside = 1; next }
+        inside && /^\t\.size/ { exit }
+        inside { print }
+    ' $1 | sed -E -e 's/_Z[0-9A-Za-z_]+/SYMBOL/g' -e 's/\.L[A-Z]*[0-9]+/.LABEL/g'
+}
+
+status=0
+for fn in oneflag twoflag threeflag allflags
+do
+    if diff <(body $1.opt.asm $fn) <(body $2.opt.asm $fn) >/dev/null
+    then
+        echo "$fn: same"
+    else
+        echo "$fn: different"
+        diff <(body $1.opt.asm $fn) <(body $2.opt.asm $fn)
+        status=1
+    fi
+done
+exit $status
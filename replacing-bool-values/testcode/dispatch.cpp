@@ -0,0 +1,153 @@
+#include <iostream>
+#include <bitset>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+#include "benchmark.h"
+#include "dispatch.h"
+#include "inputs.h"
+
+// Compares three ways of passing N flags, for N from 3 to 8, when the flags
+// are only known at run time:
+//
+//   bools  - a separate bool parameter for each flag, as in bools.cpp
+//   bitset - a std::bitset<N> parameter, as in bitset-pos.cpp
+//   table  - a template<bool...> function, as in functions.cpp, selected
+//            from a DispatchTable
+//
+// Each function generalises threeflag: every flag but the last adds or
+// subtracts a value, and the last one multiplies by a value or twice it. For
+// N = 3 this is exactly what threeflag does.
+
+template<class... Bools>
+int nflags(Bools... flags)
+{
+    constexpr std::size_t N = sizeof...(Bools);
+    const bool f[N] = {flags...};
+    int v = 0;
+    for (std::size_t i = 0; i + 1 < N; ++i)
+    {
+        int vi = inputs::next_value();
+        v = f[i] ? (v + vi) : (v - vi);
+    }
+    int vn = inputs::next_value();
+    return f[N - 1] ? (v * vn) : (v * 2 * vn);
+}
+
+template<std::size_t N>
+int nflags_bitset(std::bitset<N> f)
+{
+    int v = 0;
+    for (std::size_t i = 0; i + 1 < N; ++i)
+    {
+        int vi = inputs::next_value();
+        v = f[i] ? (v + vi) : (v - vi);
+    }
+    int vn = inputs::next_value();
+    return f[N - 1] ? (v * vn) : (v * 2 * vn);
+}
+
+template<bool... Flags>
+struct NFlags
+{
+    static int call()
+    {
+        constexpr std::size_t N = sizeof...(Flags);
+        constexpr bool f[N] = {Flags...};
+        int v = 0;
+        for (std::size_t i = 0; i + 1 < N; ++i)
+        {
+            int vi = inputs::next_value();
+            v = f[i] ? (v + vi) : (v - vi);
+        }
+        int vn = inputs::next_value();
+        return f[N - 1] ? (v * vn) : (v * 2 * vn);
+    }
+};
+
+template<std::size_t... I>
+int call_bools(unsigned c, std::index_sequence<I...>)
+{
+    return nflags(((c >> I) & 1) != 0 ...);
+}
+
+// Random flag combinations, up to 8 bits each.
+constexpr std::size_t combo_count = 4096;
+std::vector<unsigned char> combos;
+thread_local std::size_t combo_pos = 0;
+
+inline unsigned next_combo()
+{
+    return combos[combo_pos++ & (combo_count - 1)];
+}
+
+template<std::size_t N>
+int with_bools()
+{
+    return call_bools(next_combo(), std::make_index_sequence<N>{});
+}
+
+template<std::size_t N>
+int with_bitset()
+{
+    return nflags_bitset<N>(next_combo());
+}
+
+template<std::size_t N>
+int with_table()
+{
+    return DispatchTable<N, NFlags, int()>::call(next_combo());
+}
+
+// Run each version 1000 times from the same starting point and check they
+// give the same sum, then register them with the harness.
+template<std::size_t N>
+bool add_cases(std::string& check)
+{
+    int sums[3] = {};
+    int (*const fns[3])() = {with_bools<N>, with_bitset<N>, with_table<N>};
+    for (int j = 0; j < 3; ++j)
+    {
+        inputs::reset();
+        combo_pos = 0;
+        for (int i = 0; i < 1'000; ++i)
+        {
+            sums[j] += fns[j]();
+        }
+    }
+    if (sums[1] != sums[0] || sums[2] != sums[0])
+    {
+        std::cerr << fmt::format("N={}: bools={} bitset={} table={}\n", N, sums[0], sums[1], sums[2]);
+        return false;
+    }
+    check += fmt::format(" v{}={}", N, sums[0]);
+
+    bench::add(fmt::format("dispatch-{}-bools", N), 1, with_bools<N>);
+    bench::add(fmt::format("dispatch-{}-bitset", N), 1, with_bitset<N>);
+    bench::add(fmt::format("dispatch-{}-table", N), 1, with_table<N>);
+    return true;
+}
+
+template<std::size_t... N>
+bool add_all_cases(std::string& check, std::index_sequence<N...>)
+{
+    return (add_cases<N + 3>(check) && ...);
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::XorShift32 gen(1);
+    combos.resize(combo_count);
+    for (auto& c: combos)
+    {
+        c = gen() & 0xff;
+    }
+
+    std::string check;
+    if (!add_all_cases(check, std::make_index_sequence<6>{}))
+    {
+        return 1;
+    }
+    return bench::run(argc, argv, fmt::format("{} - dispatch", check.substr(1)));
+}
@@ -0,0 +1,82 @@
+// Run-time selection of template<bool...> instantiations.
+//
+// functions.cpp shows that making the flags template arguments lets the
+// compiler fold them away, but only if the caller knows the flags at compile
+// time. DispatchTable builds, at compile time, a table of pointers to all 2^N
+// instantiations of a function, indexed by the flags packed into the bits of
+// an integer (bit 0 for the first flag). Choosing the function for a set of
+// run-time flags is then a single indirect call, however many flags there are.
+//
+// The function is given as a class template with a static member function
+// called call, as a function template cannot itself be a template argument:
+//
+//     template<bool... Flags>
+//     struct MyFunction
+//     {
+//         static int call(int arg);
+//     };
+//
+//     using Table = DispatchTable<3, MyFunction, int(int)>;
+//     int v = Table::call(0b101, 10);   // MyFunction<true, false, true>::call(10)
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <utility>
+
+template<std::size_t N, template<bool...> class F, class Signature>
+class DispatchTable;
+
+template<std::size_t N, template<bool...> class F, class Ret, class... Args>
+class DispatchTable<N, F, Ret(Args...)>
+{
+    static_assert(N <= 16, "a table for more than 16 flags would be too big");
+
+public:
+    using Function = Ret (*)(Args...);
+    static constexpr std::size_t size = std::size_t(1) << N;
+
+    // Call the instantiation for the flags in the bits of an integer. Bits
+    // above the first N are ignored.
+    static Ret call(unsigned long bits, Args... args)
+    {
+        return table[bits & (size - 1)](std::forward<Args>(args)...);
+    }
+
+    static Ret call(const std::bitset<N>& bits, Args... args)
+    {
+        return call(bits.to_ulong(), std::forward<Args>(args)...);
+    }
+
+    // Pack the flags into the bits of an integer, first flag in bit 0.
+    template<class... Bools>
+    static constexpr unsigned long to_bits(Bools... flags)
+    {
+        static_assert(sizeof...(Bools) == N, "wrong number of flags");
+        unsigned long bits = 0;
+        unsigned long bit = 1;
+        ((bits |= flags ? bit : 0, bit <<= 1), ...);
+        return bits;
+    }
+
+private:
+    template<std::size_t Bits, std::size_t... I>
+    static constexpr Function instance(std::index_sequence<I...>)
+    {
+        return &F<((Bits >> I) & 1) != 0 ...>::call;
+    }
+
+    template<std::size_t... Bits>
+    static constexpr std::array<Function, size> make_table(std::index_sequence<Bits...>)
+    {
+        return {instance<Bits>(std::make_index_sequence<N>{})...};
+    }
+
+    static constexpr std::array<Function, size> table =
+        make_table(std::make_index_sequence<size>{});
+};
+
+#endif // DISPATCH_H
@@ -1,7 +1,7 @@
-#include <cstdlib>
 #include <iostream>
-#include <ctime>
 #include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
 
 enum class First { False, True };
 enum class Second { False, True };
@@ -9,14 +9,14 @@ enum class Third { False, True };
 
 int oneflag(First f1)
 {
-    int v1 = rand() % 64;
+    int v1 = inputs::next_value();
     return f1 == First::True ? v1 : -v1;
 }
 
 int twoflag(First f1, Second f2)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
     int v = f1 == First::True ? v1 : -v1;
     v = f2 == Second::True ? (v + v2) : (v - v2);
     return v;
@@ -24,45 +24,65 @@ int twoflag(First f1, Second f2)
 
 int threeflag(First f1, Second f2, Third f3)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
-    int v3 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
+    int v3 = inputs::next_value();
     int v = f1 == First::True ? v1 : -v1;
     v = f2 == Second::True ? (v + v2) : (v - v2);
     v = f3 == Third::True ? (v * v3) : (v * 2 * v3);
     return v;
 }
 
-int main()
+int allflags()
 {
-    std::srand(1);
     int v = 0;
 
-    auto begin = std::clock();
+    v += oneflag(First::False);
+    v += oneflag(First::True);
 
-    for (int i = 0; i < 1'000; ++i)
-    {
-        v += oneflag(First::False);
-        v += oneflag(First::True);
+    v += twoflag(First::False, Second::False);
+    v += twoflag(First::False, Second::True);
+    v += twoflag(First::True, Second::False);
+    v += twoflag(First::True, Second::True);
 
-        v += twoflag(First::False, Second::False);
-        v += twoflag(First::False, Second::True);
-        v += twoflag(First::True, Second::False);
-        v += twoflag(First::True, Second::True);
+    v += threeflag(First::False, Second::False, Third::False);
+    v += threeflag(First::False, Second::False, Third::True);
+    v += threeflag(First::False, Second::True, Third::False);
+    v += threeflag(First::False, Second::True, Third::True);
+    v += threeflag(First::True, Second::False, Third::False);
+    v += threeflag(First::True, Second::False, Third::True);
+    v += threeflag(First::True, Second::True, Third::False);
+    v += threeflag(First::True, Second::True, Third::True);
 
-        v += threeflag(First::False, Second::False, Third::False);
-        v += threeflag(First::False, Second::False, Third::True);
-        v += threeflag(First::False, Second::True, Third::False);
-        v += threeflag(First::False, Second::True, Third::True);
-        v += threeflag(First::True, Second::False, Third::False);
-        v += threeflag(First::True, Second::False, Third::True);
-        v += threeflag(First::True, Second::True, Third::False);
-        v += threeflag(First::True, Second::True, Third::True);
-    }
+    return v;
+}
+
+// Call each function once with the flags given by the bits of c.
+int randomflags(unsigned c)
+{
+    auto f1 = static_cast<First>(c & 1);
+    auto f2 = static_cast<Second>((c >> 1) & 1);
+    auto f3 = static_cast<Third>((c >> 2) & 1);
+    int v = oneflag(f1);
+    v += twoflag(f1, f2);
+    v += threeflag(f1, f2, f3);
+
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::reset();
+    int v = 0;
+    int r = 0;
 
-    auto end = std::clock();
-    auto time = 1000000.0 * (end - begin)/CLOCKS_PER_SEC;
+    for (int i = 0; i < 1'000; ++i)
+    {
+        v += allflags();
+        r += randomflags(inputs::next_flags());
+    }
 
-    std::clog << fmt::format("{}\n", time);
-    std::cout << fmt::format("v={} : Time={} us - enum-scoped\n", v, time);
+    bench::add("enum-scoped", 14, allflags);
+    bench::add("enum-scoped-random", 3, [] { return randomflags(inputs::next_flags()); });
+    return bench::run(argc, argv, fmt::format("v={} r={} - enum-scoped", v, r));
 }
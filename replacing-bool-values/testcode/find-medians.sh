@@ -3,61 +3,34 @@
 # Make sure all programs built
 make
 
-# File to hold the median times from each program
-mediansfile="medians.txt"
-if [ -f $mediansfile ]
-then
-    rm $mediansfile
-fi
-
-# Run each program 101 times and then grab the median value
+# Each program repeats its timed run numruns times itself and reports the
+# statistics as CSV, so we only need to start each one once.
 numruns=101
-lastidx=$((numruns-1))
-mednum=$(($lastidx/2))
-for i in *.opt
-do
-    echo "Running $i"
-    timefile="$(basename $i .opt).times"
-    if [ -f $timefile ]
-    then
-        rm $timefile
-    fi
-    j=0
-    while [[ $j -lt ${numruns} ]]
-    do
-        ./$i 2>>$timefile >/dev/null
-        (( j += 1 ))
-    done
-    sort -n $timefile >$timefile.tmp
-    mv $timefile.tmp $timefile
-    median=$(head -$mednum $timefile | tail -1)
-    mode=$(sort $timefile | uniq -c | sort -n | tail -1 | sed -E -e 's/ *([0-9]+)+ +([0-9]+)/\2 (\1)/')
-    echo "median=$median, mode=$mode : $i" >>$mediansfile
-done
-
-mediansfile="medians.noopt.txt"
-if [ -f $mediansfile ]
-then
-    rm $mediansfile
-fi
 
-for i in *.noopt
-do
-    echo "Running no-opt $i"
-    timefile=$i.times
-    if [ -f $timefile ]
+# Run every program matching the pattern in $1 and gather the results in the
+# CSV file $2, adding the program name as the first column.
+function collect
+{
+    pattern=$1
+    resultsfile=$2
+    header=""
+    if [ -f $resultsfile ]
     then
-        rm $timefile
+        rm $resultsfile
     fi
-    j=0
-    while [[ $j -lt ${numruns} ]]
+    for i in $pattern
     do
-        ./$i 2>>$timefile >/dev/null
-        (( j += 1 ))
+        echo "Running $i"
+        ./$i --repetitions=$numruns --min-time=20 --format=csv >$i.csv
+        if [ -z "$header" ]
+        then
+            header="program,$(head -1 $i.csv)"
+            echo "$header" >$resultsfile
+        fi
+        tail -n +2 $i.csv | sed -e "s/^/$i,/" >>$resultsfile
+        rm $i.csv
     done
-    sort -n $timefile >$timefile.tmp
-    mv $timefile.tmp $timefile
-    median=$(head -$mednum $timefile | tail -1)
-    mode=$(sort $timefile | uniq -c | sort -n | tail -1 | sed -E -e 's/ *([0-9]+)+ +([0-9]+)/\2 (\1)/')
-    echo "median=$median, mode=$mode : $i" >>$mediansfile
-done
+}
+
+collect "*.opt" medians.csv
+collect "*.noopt" medians.noopt.csv
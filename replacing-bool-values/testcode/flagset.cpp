@@ -0,0 +1,90 @@
+#include <iostream>
+#include <type_traits>
+#include <fmt/format.h>
+#include "benchmark.h"
+#include "flagset.h"
+#include "inputs.h"
+
+enum class Flag { First, Second, Third };
+using Flags = FlagSet<Flag>;
+
+static_assert(sizeof(Flags) == sizeof(int));
+static_assert(std::is_trivially_copyable_v<Flags>);
+
+int oneflag(Flags f)
+{
+    int v1 = inputs::next_value();
+    return f.test(Flag::First) ? v1 : -v1;
+}
+
+int twoflag(Flags f)
+{
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
+    int v = f.test(Flag::First) ? v1 : -v1;
+    v = f.test(Flag::Second) ? (v + v2) : (v - v2);
+    return v;
+}
+
+int threeflag(Flags f)
+{
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
+    int v3 = inputs::next_value();
+    int v = f.test(Flag::First) ? v1 : -v1;
+    v = f.test(Flag::Second) ? (v + v2) : (v - v2);
+    v = f.test(Flag::Third) ? (v * v3) : (v * 2 * v3);
+    return v;
+}
+
+int allflags()
+{
+    int v = 0;
+
+    v += oneflag({});
+    v += oneflag(Flag::First);
+
+    v += twoflag({});
+    v += twoflag(Flag::Second);
+    v += twoflag(Flag::First);
+    v += twoflag({Flag::First, Flag::Second});
+
+    v += threeflag({});
+    v += threeflag(Flag::Third);
+    v += threeflag(Flag::Second);
+    v += threeflag({Flag::Second, Flag::Third});
+    v += threeflag(Flag::First);
+    v += threeflag({Flag::First, Flag::Third});
+    v += threeflag({Flag::First, Flag::Second});
+    v += threeflag({Flag::First, Flag::Second, Flag::Third});
+
+    return v;
+}
+
+// Call each function once with the flags given by the bits of c.
+int randomflags(unsigned c)
+{
+    auto f = Flags::from_bits(c);
+    int v = oneflag(f);
+    v += twoflag(f);
+    v += threeflag(f);
+
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::reset();
+    int v = 0;
+    int r = 0;
+
+    for (int i = 0; i < 1'000; ++i)
+    {
+        v += allflags();
+        r += randomflags(inputs::next_flags());
+    }
+
+    bench::add("flagset", 14, allflags);
+    bench::add("flagset-random", 3, [] { return randomflags(inputs::next_flags()); });
+    return bench::run(argc, argv, fmt::format("v={} r={} - flagset", v, r));
+}
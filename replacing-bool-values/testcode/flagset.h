@@ -0,0 +1,174 @@
+// A type-safe set of flags named by a scoped enum.
+//
+// enum-scoped.cpp needs a separate enum class for every flag, and the bitset
+// constants in bitset-consts.cpp have no names tying them to the function they
+// belong with. FlagSet<Enum> holds any combination of the enumerators of one
+// enum class as bits of an unsigned integer, where each enumerator's value is
+// its bit position:
+//
+//     enum class Option { Verbose, DryRun, Force };
+//     using Options = FlagSet<Option>;
+//
+//     void run(Options opts);
+//     run({Option::Verbose, Option::Force});
+//     if (opts.test(Option::DryRun)) ...
+//
+// All the operations are constexpr and the class is trivially copyable and
+// the same size as its underlying integer, so it is passed in a register and
+// should generate the same code as using an int with hand-written masks.
+
+#ifndef FLAGSET_H
+#define FLAGSET_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+template<class Enum, class Bits = std::uint32_t>
+class FlagSet
+{
+    static_assert(std::is_enum_v<Enum>, "FlagSet needs an enum type");
+    static_assert(std::is_unsigned_v<Bits>, "FlagSet needs an unsigned integer type for its bits");
+
+public:
+    using enum_type = Enum;
+    using bits_type = Bits;
+
+    constexpr FlagSet() noexcept = default;
+
+    // Not explicit, so a single enumerator can be passed where a FlagSet is
+    // expected.
+    constexpr FlagSet(Enum flag) noexcept
+    : bits_(mask(flag))
+    {
+    }
+
+    template<class... Flags,
+             class = std::enable_if_t<(sizeof...(Flags) > 1)
+                                      && (std::is_same_v<Flags, Enum> && ...)>>
+    constexpr FlagSet(Flags... flags) noexcept
+    : bits_((mask(flags) | ...))
+    {
+    }
+
+    static constexpr FlagSet from_bits(Bits bits) noexcept
+    {
+        FlagSet f;
+        f.bits_ = bits;
+        return f;
+    }
+
+    constexpr Bits bits() const noexcept { return bits_; }
+
+    constexpr bool test(Enum flag) const noexcept { return (bits_ & mask(flag)) != 0; }
+    constexpr bool any() const noexcept { return bits_ != 0; }
+    constexpr bool none() const noexcept { return bits_ == 0; }
+    constexpr int count() const noexcept { return std::popcount(bits_); }
+
+    constexpr bool all_of(FlagSet other) const noexcept
+    {
+        return (bits_ & other.bits_) == other.bits_;
+    }
+
+    constexpr FlagSet& set(Enum flag) noexcept
+    {
+        bits_ |= mask(flag);
+        return *this;
+    }
+
+    constexpr FlagSet& set(Enum flag, bool value) noexcept
+    {
+        return value ? set(flag) : clear(flag);
+    }
+
+    constexpr FlagSet& clear(Enum flag) noexcept
+    {
+        bits_ &= static_cast<Bits>(~mask(flag));
+        return *this;
+    }
+
+    constexpr FlagSet& flip(Enum flag) noexcept
+    {
+        bits_ ^= mask(flag);
+        return *this;
+    }
+
+    constexpr FlagSet& operator|=(FlagSet other) noexcept
+    {
+        bits_ |= other.bits_;
+        return *this;
+    }
+
+    constexpr FlagSet& operator&=(FlagSet other) noexcept
+    {
+        bits_ &= other.bits_;
+        return *this;
+    }
+
+    constexpr FlagSet& operator^=(FlagSet other) noexcept
+    {
+        bits_ ^= other.bits_;
+        return *this;
+    }
+
+    friend constexpr FlagSet operator|(FlagSet a, FlagSet b) noexcept { return a |= b; }
+    friend constexpr FlagSet operator&(FlagSet a, FlagSet b) noexcept { return a &= b; }
+    friend constexpr FlagSet operator^(FlagSet a, FlagSet b) noexcept { return a ^= b; }
+    friend constexpr bool operator==(FlagSet a, FlagSet b) noexcept { return a.bits_ == b.bits_; }
+    friend constexpr bool operator!=(FlagSet a, FlagSet b) noexcept { return a.bits_ != b.bits_; }
+
+    // Iterates over the flags that are set, lowest bit position first. Each
+    // step just clears the lowest set bit, and std::countr_zero turns it back
+    // into an enumerator.
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Enum;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Enum*;
+        using reference = Enum;
+
+        constexpr iterator() noexcept = default;
+        constexpr explicit iterator(Bits bits) noexcept : bits_(bits) {}
+
+        constexpr Enum operator*() const noexcept
+        {
+            return static_cast<Enum>(std::countr_zero(bits_));
+        }
+
+        constexpr iterator& operator++() noexcept
+        {
+            bits_ &= bits_ - 1;
+            return *this;
+        }
+
+        constexpr iterator operator++(int) noexcept
+        {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend constexpr bool operator==(iterator a, iterator b) noexcept { return a.bits_ == b.bits_; }
+        friend constexpr bool operator!=(iterator a, iterator b) noexcept { return a.bits_ != b.bits_; }
+
+    private:
+        Bits bits_ = 0;
+    };
+
+    constexpr iterator begin() const noexcept { return iterator(bits_); }
+    constexpr iterator end() const noexcept { return iterator(); }
+
+private:
+    static constexpr Bits mask(Enum flag) noexcept
+    {
+        return static_cast<Bits>(Bits{1} << static_cast<unsigned>(flag));
+    }
+
+    Bits bits_ = 0;
+};
+
+#endif // FLAGSET_H
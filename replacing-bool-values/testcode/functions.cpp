@@ -1,12 +1,12 @@
-#include <cstdlib>
 #include <iostream>
-#include <ctime>
 #include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
 
 template<bool b1>
 int oneflag()
 {
-    int v1 = rand() % 64;
+    int v1 = inputs::next_value();
     return b1 ? v1 : -v1;
 }
 
@@ -14,7 +14,7 @@ template<bool b1, bool b2>
 int twoflags()
 {
     int v1 = oneflag<b1>();
-    int v2 = rand() % 64;
+    int v2 = inputs::next_value();
     return b2 ? v1 + v2 : v1 - v2;
 }
 
@@ -22,40 +22,76 @@ template<bool b1, bool b2, bool b3>
 int threeflags()
 {
     int v1 = twoflags<b1, b2>();
-    int v2 = rand() % 64;
+    int v2 = inputs::next_value();
     return b3 ? v1 * v2 : v1 * (2*v2);
 }
 
-int main()
+int allflags()
 {
-    std::srand(1);
     int v = 0;
 
-    auto begin = std::clock();
+    v += oneflag<false>();
+    v += oneflag<true>();
 
-    for (int i = 0; i < 1'000; ++i)
+    v += twoflags<false,false>();
+    v += twoflags<false,true>();
+    v += twoflags<true,false>();
+    v += twoflags<true,true>();
+
+    v += threeflags<false,false,false>();
+    v += threeflags<false,false,true>();
+    v += threeflags<false,true,false>();
+    v += threeflags<false,true,true>();
+    v += threeflags<true,false,false>();
+    v += threeflags<true,false,true>();
+    v += threeflags<true,true,false>();
+    v += threeflags<true,true,true>();
+
+    return v;
+}
+
+// Call each function once with the flags given by the bits of c. As the flags
+// are template arguments we have to choose the function to call at run time.
+int randomflags(unsigned c)
+{
+    int v = (c & 1) ? oneflag<true>() : oneflag<false>();
+
+    switch (c & 3)
+    {
+    case 0: v += twoflags<false,false>(); break;
+    case 1: v += twoflags<true,false>(); break;
+    case 2: v += twoflags<false,true>(); break;
+    case 3: v += twoflags<true,true>(); break;
+    }
+
+    switch (c & 7)
     {
-        v += oneflag<false>();
-        v += oneflag<true>();
-
-        v += twoflags<false,false>();
-        v += twoflags<false,true>();
-        v += twoflags<true,false>();
-        v += twoflags<true,true>();
-
-        v += threeflags<false,false,false>();
-        v += threeflags<false,false,true>();
-        v += threeflags<false,true,false>();
-        v += threeflags<false,true,true>();
-        v += threeflags<true,false,false>();
-        v += threeflags<true,false,true>();
-        v += threeflags<true,true,false>();
-        v += threeflags<true,true,true>();
+    case 0: v += threeflags<false,false,false>(); break;
+    case 1: v += threeflags<true,false,false>(); break;
+    case 2: v += threeflags<false,true,false>(); break;
+    case 3: v += threeflags<true,true,false>(); break;
+    case 4: v += threeflags<false,false,true>(); break;
+    case 5: v += threeflags<true,false,true>(); break;
+    case 6: v += threeflags<false,true,true>(); break;
+    case 7: v += threeflags<true,true,true>(); break;
     }
 
-    auto end = std::clock();
-    auto time = 1000000.0 * (end - begin)/CLOCKS_PER_SEC;
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::reset();
+    int v = 0;
+    int r = 0;
+
+    for (int i = 0; i < 1'000; ++i)
+    {
+        v += allflags();
+        r += randomflags(inputs::next_flags());
+    }
 
-    std::clog << fmt::format("{}\n", time);
-    std::cout << fmt::format("v={} : Time={} us - functions\n", v, time);
+    bench::add("functions", 14, allflags);
+    bench::add("functions-random", 3, [] { return randomflags(inputs::next_flags()); });
+    return bench::run(argc, argv, fmt::format("v={} r={} - functions", v, r));
 }
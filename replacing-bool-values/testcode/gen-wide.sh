@@ -0,0 +1,283 @@
+#!/bin/bash
+
+# Generates wide.cpp on standard output.
+#
+# The other programs stop at three flags. This writes functions taking N flags,
+# for each N in the sizes variable, using each of the ways of passing flags from
+# the other programs:
+#
+#   bools            - a separate bool parameter for each flag (bools.cpp)
+#   ints             - bits of an unsigned integer (ints.cpp)
+#   bitset           - a std::bitset<N> (bitset-pos.cpp)
+#   struct-bitfields - a struct with a one bit bitfield per flag (struct-bitfields.cpp)
+#   struct-bools     - a struct with a bool per flag (struct-bools.cpp)
+#   enums            - a separate enum class parameter for each flag (enum-scoped.cpp)
+#
+# Some of these can't be written as templates, as they need a differently named
+# member, parameter or type for every flag, which is why this is a script.
+#
+# Each function adds or subtracts one value per flag, and the functions are
+# marked noinline so the cost of passing the flags is always included.
+
+sizes="1 3 8 16 32 64"
+
+function flags
+{
+    seq 0 $(($1 - 1))
+}
+
+# Write a function body, one step per flag. $2 is the test for a flag, with @
+# standing for the flag's index.
+function body
+{
+    echo "{"
+    echo "    int v = 0;"
+    for i in $(flags $1)
+    do
+        echo "    v = step(v, ${2//@/$i});"
+    done
+    echo "    return v;"
+    echo "}"
+    echo
+}
+
+# Write a parameter list of one parameter per flag, of type $2 with @ standing
+# for the flag's index.
+function params
+{
+    local sep=""
+    for i in $(flags $1)
+    do
+        echo -n "$sep${2//@/$i} f$i"
+        sep=", "
+    done
+}
+
+# Write an argument list of member fN of $2 for each flag.
+function args
+{
+    local sep=""
+    for i in $(flags $1)
+    do
+        echo -n "${sep}$2.f$i"
+        sep=", "
+    done
+}
+
+cat <<'EOF'
+// Generated by gen-wide.sh - edit that rather than this file.
+
+#include <iostream>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
+
+// Add or subtract the next value depending on a flag.
+inline int step(int v, bool f)
+{
+    int x = inputs::next_value();
+    return f ? (v + x) : (v - x);
+}
+
+// Each call takes its flags from the next of these random inputs, held in
+// the form each version passes them in. The count is kept small enough that
+// the inputs for the largest types stay in the cache.
+constexpr std::size_t input_count = 256;
+thread_local std::size_t input_pos = 0;
+
+inline std::size_t next_input()
+{
+    return input_pos++ & (input_count - 1);
+}
+
+std::vector<std::uint64_t> random_bits()
+{
+    inputs::XorShift32 gen(1);
+    std::vector<std::uint64_t> bits(input_count);
+    for (auto& b: bits)
+    {
+        b = (std::uint64_t{gen()} << 32) | gen();
+    }
+    return bits;
+}
+
+// Sum the results of 1000 calls from the same starting point, so the versions
+// can be checked against each other.
+int checksum(int (*f)())
+{
+    inputs::reset();
+    input_pos = 0;
+    int v = 0;
+    for (int i = 0; i < 1'000; ++i)
+    {
+        v += f();
+    }
+    return v;
+}
+
+// Under the x86-64 System V ABI the first six integer arguments are passed in
+// registers, and so is a trivially copyable struct of up to 16 bytes that
+// fits in the remaining ones. This gives a rough idea of which versions need
+// to pass the flags in memory.
+constexpr bool separate_in_regs(std::size_t n) { return n <= 6; }
+
+template<class T>
+constexpr bool struct_in_regs()
+{
+    return sizeof(T) <= 16 && std::is_trivially_copyable_v<T>;
+}
+
+EOF
+
+for n in $sizes
+do
+    if [ $n -le 32 ]
+    then
+        bits="std::uint32_t"
+    else
+        bits="std::uint64_t"
+    fi
+    if [ $n -eq 64 ]
+    then
+        mask="~std::uint64_t{0}"
+    else
+        mask="(std::uint64_t{1} << $n) - 1"
+    fi
+
+    echo "// $n flag(s)"
+    echo
+    echo "using Int$n = $bits;"
+    echo
+    echo "struct Bools$n"
+    echo "{"
+    for i in $(flags $n); do echo "    bool f$i;"; done
+    echo "};"
+    echo
+    echo "struct Bitfields$n"
+    echo "{"
+    for i in $(flags $n); do echo "    $bits f$i : 1;"; done
+    echo "};"
+    echo
+    for i in $(flags $n); do echo "enum class E${n}_$i { False, True };"; done
+    echo
+    echo "struct Enums$n"
+    echo "{"
+    for i in $(flags $n); do echo "    E${n}_$i f$i;"; done
+    echo "};"
+    echo
+
+    echo "[[gnu::noinline]] int bools$n($(params $n "bool"))"
+    body $n "f@"
+    echo "[[gnu::noinline]] int ints$n(Int$n f)"
+    body $n "(f & (Int$n{1} << @)) != 0"
+    echo "[[gnu::noinline]] int bitset$n(std::bitset<$n> f)"
+    body $n "f[@]"
+    echo "[[gnu::noinline]] int struct_bitfields$n(Bitfields$n f)"
+    body $n "f.f@ == 1"
+    echo "[[gnu::noinline]] int struct_bools$n(Bools$n f)"
+    body $n "f.f@"
+    echo "[[gnu::noinline]] int enums$n($(params $n "E${n}_@"))"
+    body $n "f@ == E${n}_@::True"
+
+    echo "std::vector<Int$n> ints${n}_in;"
+    echo "std::vector<std::bitset<$n>> bitset${n}_in;"
+    echo "std::vector<Bitfields$n> bitfields${n}_in;"
+    echo "std::vector<Bools$n> bools${n}_in;"
+    echo "std::vector<Enums$n> enums${n}_in;"
+    echo
+    echo "void make_inputs$n(const std::vector<std::uint64_t>& bits)"
+    echo "{"
+    echo "    for (auto b: bits)"
+    echo "    {"
+    echo "        b &= $mask;"
+    echo "        ints${n}_in.push_back(static_cast<Int$n>(b));"
+    echo "        bitset${n}_in.emplace_back(b);"
+    echo "        Bitfields$n bf{};"
+    echo "        Bools$n bs{};"
+    echo "        Enums$n es{};"
+    for i in $(flags $n)
+    do
+        echo "        bf.f$i = (b >> $i) & 1;"
+        echo "        bs.f$i = (b >> $i) & 1;"
+        echo "        es.f$i = static_cast<E${n}_$i>((b >> $i) & 1);"
+    done
+    echo "        bitfields${n}_in.push_back(bf);"
+    echo "        bools${n}_in.push_back(bs);"
+    echo "        enums${n}_in.push_back(es);"
+    echo "    }"
+    echo "}"
+    echo
+    echo "int call_bools$n()"
+    echo "{"
+    echo "    const auto& f = bools${n}_in[next_input()];"
+    echo "    return bools$n($(args $n f));"
+    echo "}"
+    echo
+    echo "int call_ints$n() { return ints$n(ints${n}_in[next_input()]); }"
+    echo "int call_bitset$n() { return bitset$n(bitset${n}_in[next_input()]); }"
+    echo "int call_struct_bitfields$n() { return struct_bitfields$n(bitfields${n}_in[next_input()]); }"
+    echo "int call_struct_bools$n() { return struct_bools$n(bools${n}_in[next_input()]); }"
+    echo
+    echo "int call_enums$n()"
+    echo "{"
+    echo "    const auto& f = enums${n}_in[next_input()];"
+    echo "    return enums$n($(args $n f));"
+    echo "}"
+    echo
+    echo "bool add_cases$n(std::string& check)"
+    echo "{"
+    echo "    int v = checksum(call_bools$n);"
+    echo "    for (auto f: {call_ints$n, call_bitset$n, call_struct_bitfields$n, call_struct_bools$n, call_enums$n})"
+    echo "    {"
+    echo "        if (checksum(f) != v)"
+    echo "        {"
+    echo "            std::cerr << \"Results differ for $n flag(s)\\n\";"
+    echo "            return false;"
+    echo "        }"
+    echo "    }"
+    echo "    check += fmt::format(\" v$n={}\", v);"
+    echo
+    echo "    bench::add(\"wide-$n-bools\", 1, call_bools$n).info ="
+    echo "        {{\"size\", $n * sizeof(bool)}, {\"align\", alignof(bool)}, {\"args\", $n}, {\"in_regs\", separate_in_regs($n)}};"
+    echo "    bench::add(\"wide-$n-ints\", 1, call_ints$n).info ="
+    echo "        {{\"size\", sizeof(Int$n)}, {\"align\", alignof(Int$n)}, {\"args\", 1}, {\"in_regs\", struct_in_regs<Int$n>()}};"
+    echo "    bench::add(\"wide-$n-bitset\", 1, call_bitset$n).info ="
+    echo "        {{\"size\", sizeof(std::bitset<$n>)}, {\"align\", alignof(std::bitset<$n>)}, {\"args\", 1}, {\"in_regs\", struct_in_regs<std::bitset<$n>>()}};"
+    echo "    bench::add(\"wide-$n-struct-bitfields\", 1, call_struct_bitfields$n).info ="
+    echo "        {{\"size\", sizeof(Bitfields$n)}, {\"align\", alignof(Bitfields$n)}, {\"args\", 1}, {\"in_regs\", struct_in_regs<Bitfields$n>()}};"
+    echo "    bench::add(\"wide-$n-struct-bools\", 1, call_struct_bools$n).info ="
+    echo "        {{\"size\", sizeof(Bools$n)}, {\"align\", alignof(Bools$n)}, {\"args\", 1}, {\"in_regs\", struct_in_regs<Bools$n>()}};"
+    echo "    bench::add(\"wide-$n-enums\", 1, call_enums$n).info ="
+    echo "        {{\"size\", $n * sizeof(E${n}_0)}, {\"align\", alignof(E${n}_0)}, {\"args\", $n}, {\"in_regs\", separate_in_regs($n)}};"
+    echo "    return true;"
+    echo "}"
+    echo
+done
+
+echo "int main(int argc, char* argv[])"
+echo "{"
+echo "    auto bits = random_bits();"
+for n in $sizes
+do
+    echo "    make_inputs$n(bits);"
+done
+echo
+echo "    std::string check;"
+echo -n "    if (!("
+sep=""
+for n in $sizes
+do
+    echo -n "${sep}add_cases$n(check)"
+    sep=" && "
+done
+echo "))"
+echo "    {"
+echo "        return 1;"
+echo "    }"
+echo "    return bench::run(argc, argv, fmt::format(\"{} - wide\", check.substr(1)));"
+echo "}"
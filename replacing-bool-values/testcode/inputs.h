@@ -0,0 +1,89 @@
+// Input values for the flag passing test programs.
+//
+// The functions being timed need values the compiler cannot work out in
+// advance. They used to call rand(), but that takes a lock on the C library's
+// global generator state and cost more than the flag handling we want to
+// compare. Instead the values are generated once, using a small xorshift
+// generator, into a buffer small enough to stay in the L1 cache, and the
+// functions just read the next value from it.
+//
+// A second buffer holds random flag combinations, with bit 0 for the first
+// flag, bit 1 for the second and bit 2 for the third. Feeding these to the
+// functions in place of the fixed sequence of calls in allflags() stops the
+// branch predictor learning the pattern.
+
+#ifndef INPUTS_H
+#define INPUTS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace inputs
+{
+
+// Marsaglia's 32-bit xorshift generator. Not good enough for statistics, but
+// plenty for making values the compiler can't predict.
+class XorShift32
+{
+public:
+    explicit XorShift32(std::uint32_t seed)
+    : state_(seed ? seed : 1)
+    {
+    }
+
+    std::uint32_t operator()()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+private:
+    std::uint32_t state_;
+};
+
+// Both sizes must be powers of two so the position can be wrapped with a mask.
+constexpr std::size_t value_count = 4096;
+constexpr std::size_t flags_count = 4096;
+
+// The buffers are shared, but each thread reads through them from its own
+// position so the programs can be run with --threads.
+inline unsigned char values[value_count];
+inline thread_local std::size_t value_pos = 0;
+
+inline unsigned char flags[flags_count];
+inline thread_local std::size_t flags_pos = 0;
+
+// Fill both buffers from the given seed and start reading from the beginning,
+// so every program sees the same values in the same order.
+inline void reset(std::uint32_t seed = 1)
+{
+    XorShift32 gen(seed);
+    for (auto& v: values)
+    {
+        v = gen() % 64;
+    }
+    for (auto& f: flags)
+    {
+        f = gen() % 8;
+    }
+    value_pos = 0;
+    flags_pos = 0;
+}
+
+// The next value in the range 0 to 63, replacing rand() % 64.
+inline int next_value()
+{
+    return values[value_pos++ & (value_count - 1)];
+}
+
+// The next random combination of three flags.
+inline unsigned next_flags()
+{
+    return flags[flags_pos++ & (flags_count - 1)];
+}
+
+} // namespace inputs
+
+#endif // INPUTS_H
@@ -0,0 +1,168 @@
+// Hardware performance counters for the benchmark harness.
+//
+// On Linux the counters are read using perf_event_open(2), as a single group
+// so they are all enabled and disabled together around the timed code. Only
+// user space events are counted, so this works with the default
+// perf_event_paranoid setting of 2. If the counters cannot be opened (not
+// Linux, no PMU, as is common in virtual machines, or not permitted) the
+// counters are reported as unavailable and the timings are still produced.
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench
+{
+
+// Counter totals for a piece of code.
+struct CounterValues
+{
+    std::uint64_t cycles = 0;
+    std::uint64_t instructions = 0;
+    std::uint64_t branches = 0;
+    std::uint64_t branch_misses = 0;
+
+    CounterValues& operator+=(const CounterValues& other)
+    {
+        cycles += other.cycles;
+        instructions += other.instructions;
+        branches += other.branches;
+        branch_misses += other.branch_misses;
+        return *this;
+    }
+
+    double ipc() const
+    {
+        return cycles ? static_cast<double>(instructions) / cycles : 0.0;
+    }
+};
+
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+#if defined(__linux__)
+        leader_ = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (leader_ < 0)
+        {
+            error_ = std::strerror(errno);
+            return;
+        }
+        fds_[0] = leader_;
+        fds_[1] = open_counter(PERF_COUNT_HW_INSTRUCTIONS, leader_);
+        fds_[2] = open_counter(PERF_COUNT_HW_BRANCH_INSTRUCTIONS, leader_);
+        fds_[3] = open_counter(PERF_COUNT_HW_BRANCH_MISSES, leader_);
+        for (auto fd: fds_)
+        {
+            if (fd < 0)
+            {
+                error_ = std::strerror(errno);
+                close_all();
+                return;
+            }
+        }
+#else
+        error_ = "not supported on this platform";
+#endif
+    }
+
+    ~PerfCounters()
+    {
+        close_all();
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return leader_ >= 0; }
+    const std::string& error() const { return error_; }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (available())
+        {
+            ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    CounterValues stop()
+    {
+        CounterValues values;
+#if defined(__linux__)
+        if (!available())
+        {
+            return values;
+        }
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // With PERF_FORMAT_GROUP a read of the leader gives the number of
+        // counters followed by each counter's value, in the order they were
+        // opened.
+        std::uint64_t data[1 + num_counters] = {};
+        if (read(leader_, data, sizeof(data)) == static_cast<ssize_t>(sizeof(data)))
+        {
+            values.cycles = data[1];
+            values.instructions = data[2];
+            values.branches = data[3];
+            values.branch_misses = data[4];
+        }
+#endif
+        return values;
+    }
+
+private:
+    static constexpr int num_counters = 4;
+
+#if defined(__linux__)
+    static int open_counter(std::uint64_t config, int group)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = group == -1 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+
+    void close_all()
+    {
+#if defined(__linux__)
+        for (auto& fd: fds_)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            fd = -1;
+        }
+#endif
+        leader_ = -1;
+    }
+
+    int leader_ = -1;                           // also held in fds_[0]
+    int fds_[num_counters] = {-1, -1, -1, -1};
+    std::string error_;
+};
+
+} // namespace bench
+
+#endif // PERF_COUNTERS_H
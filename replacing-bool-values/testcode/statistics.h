@@ -0,0 +1,113 @@
+// Summary statistics for a set of benchmark timings.
+//
+// Run times are not normally distributed - most runs are close to the fastest
+// time, with a few much slower ones caused by other activity on the machine -
+// so the summary concentrates on order statistics (median, percentiles) and
+// the median absolute deviation (MAD) rather than the mean and standard
+// deviation.
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace bench
+{
+
+struct Summary
+{
+    std::size_t count = 0;      // number of samples taken
+    std::size_t outliers = 0;   // number rejected as outliers
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double median = 0;
+    double mad = 0;             // median absolute deviation, scaled to sigma
+    double p5 = 0;
+    double p95 = 0;
+    double ci_low = 0;          // 95% confidence interval for the median
+    double ci_high = 0;
+};
+
+// The value at fraction p (0 to 1) through a sorted list of values, linearly
+// interpolating between neighbouring values.
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    double pos = p * (sorted.size() - 1);
+    auto lo = static_cast<std::size_t>(pos);
+    auto hi = std::min(lo + 1, sorted.size() - 1);
+    double frac = pos - lo;
+    return sorted[lo] + frac * (sorted[hi] - sorted[lo]);
+}
+
+// Median absolute deviation of a sorted list, scaled by 1.4826 so it
+// estimates the standard deviation for normally distributed values.
+inline double median_abs_deviation(const std::vector<double>& sorted, double median)
+{
+    std::vector<double> dev;
+    dev.reserve(sorted.size());
+    for (auto v: sorted)
+    {
+        dev.push_back(std::fabs(v - median));
+    }
+    std::sort(dev.begin(), dev.end());
+    return 1.4826 * percentile(dev, 0.5);
+}
+
+// Summarise the samples. Any sample further than outlier_limit scaled MADs
+// from the median is rejected before the rest of the figures are worked out.
+// The confidence interval for the median uses the order statistics either
+// side of it, so it makes no assumption about the distribution.
+inline Summary summarise(std::vector<double> samples, double outlier_limit = 3.0)
+{
+    Summary s;
+    s.count = samples.size();
+    if (samples.empty())
+    {
+        return s;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double median = percentile(samples, 0.5);
+    double mad = median_abs_deviation(samples, median);
+    if (mad > 0 && outlier_limit > 0)
+    {
+        auto keep = std::remove_if(samples.begin(), samples.end(), [&](double v) {
+            return std::fabs(v - median) > outlier_limit * mad;
+        });
+        s.outliers = samples.end() - keep;
+        samples.erase(keep, samples.end());
+    }
+
+    auto n = samples.size();
+    s.min = samples.front();
+    s.max = samples.back();
+    double sum = 0;
+    for (auto v: samples)
+    {
+        sum += v;
+    }
+    s.mean = sum / n;
+    s.median = percentile(samples, 0.5);
+    s.mad = median_abs_deviation(samples, s.median);
+    s.p5 = percentile(samples, 0.05);
+    s.p95 = percentile(samples, 0.95);
+
+    double half = 1.96 * std::sqrt(static_cast<double>(n)) / 2.0;
+    auto lo = static_cast<long>(std::floor(n / 2.0 - half));
+    auto hi = static_cast<long>(std::ceil(n / 2.0 + half));
+    s.ci_low = samples[std::max(lo, 0L)];
+    s.ci_high = samples[std::min(hi, static_cast<long>(n) - 1)];
+    return s;
+}
+
+} // namespace bench
+
+#endif // STATISTICS_H
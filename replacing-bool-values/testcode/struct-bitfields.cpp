@@ -1,7 +1,7 @@
-#include <cstdlib>
 #include <iostream>
-#include <ctime>
 #include <fmt/format.h>
+#include "benchmark.h"
+#include "inputs.h"
 
 struct OneFlag
 {
@@ -23,14 +23,14 @@ struct ThreeFlags
 
 int oneflag(OneFlag f)
 {
-    int v1 = rand() % 64;
+    int v1 = inputs::next_value();
     return f.flag1 == 1 ? v1 : -v1;
 }
 
 int twoflag(TwoFlags f)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
     int v = f.flag1 == 1 ? v1 : -v1;
     v = f.flag2 == 1 ? (v + v2) : (v - v2);
     return v;
@@ -38,45 +38,65 @@ int twoflag(TwoFlags f)
 
 int threeflag(ThreeFlags f)
 {
-    int v1 = rand() % 64;
-    int v2 = rand() % 64;
-    int v3 = rand() % 64;
+    int v1 = inputs::next_value();
+    int v2 = inputs::next_value();
+    int v3 = inputs::next_value();
     int v = f.flag1 == 1 ? v1 : -v1;
     v = f.flag2 == 1 ? (v + v2) : (v - v2);
     v = f.flag3 == 1 ? (v * v3) : (v * 2 * v3);
     return v;
 }
 
-int main()
+int allflags()
 {
-    std::srand(1);
     int v = 0;
 
-    auto begin = std::clock();
+    v += oneflag({0});
+    v += oneflag({1});
+
+    v += twoflag({0,0});
+    v += twoflag({0,1});
+    v += twoflag({1,0});
+    v += twoflag({1,1});
+
+    v += threeflag({0,0,0});
+    v += threeflag({0,0,1});
+    v += threeflag({0,1,0});
+    v += threeflag({0,1,1});
+    v += threeflag({1,0,0});
+    v += threeflag({1,0,1});
+    v += threeflag({1,1,0});
+    v += threeflag({1,1,1});
+
+    return v;
+}
+
+// Call each function once with the flags given by the bits of c.
+int randomflags(unsigned c)
+{
+    unsigned f1 = c & 1;
+    unsigned f2 = (c >> 1) & 1;
+    unsigned f3 = (c >> 2) & 1;
+    int v = oneflag({f1});
+    v += twoflag({f1, f2});
+    v += threeflag({f1, f2, f3});
+
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    inputs::reset();
+    int v = 0;
+    int r = 0;
 
     for (int i = 0; i < 1'000; ++i)
     {
-        v += oneflag({0});
-        v += oneflag({1});
-
-        v += twoflag({0,0});
-        v += twoflag({0,1});
-        v += twoflag({1,0});
-        v += twoflag({1,1});
-
-        v += threeflag({0,0,0});
-        v += threeflag({0,0,1});
-        v += threeflag({0,1,0});
-        v += threeflag({0,1,1});
-        v += threeflag({1,0,0});
-        v += threeflag({1,0,1});
-        v += threeflag({1,1,0});
-        v += threeflag({1,1,1});
+        v += allflags();
+        r += randomflags(inputs::next_flags());
     }
 
-    auto end = std::clock();
-    auto time = 1000000.0 * (end - begin)/CLOCKS_PER_SEC;
-
-    std::clog << fmt::format("{}\n", time);
-    std::cout << fmt::format("v={} : Time={} us - struct-bitfields\n", v, time);
+    bench::add("struct-bitfields", 14, allflags);
+    bench::add("struct-bitfields-random", 3, [] { return randomflags(inputs::next_flags()); });
+    return bench::run(argc, argv, fmt::format("v={} r={} - struct-bitfields", v, r));
 }
@@ -0,0 +1,95 @@
+#ifdef ALLOC_PROFILE
+#include "alloc-profiler.ipp"
+#endif
+#include "timing.ipp"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How much the profiling in alloc-profiler.ipp costs. The makefile builds
+// this without ALLOC_PROFILE defined, with it, and with ALLOCPROF_SITES as
+// well, so the times can be compared. With the profiler it also prints how
+// many allocations each workload makes, measured with
+// allocprof::thread_counters(), and the summary at exit.
+
+struct Node
+{
+    int i[20];
+    std::shared_ptr<Node> next;
+};
+
+void new_delete()
+{
+    auto p = new int[8];
+    do_not_optimize(p);
+    delete[] p;
+}
+
+void shared_ptr_chain()
+{
+    auto head = std::make_shared<Node>();
+    for (int i = 0; i < 9; ++i)
+    {
+        auto n = std::make_shared<Node>();
+        n->next = head;
+        head = n;
+    }
+    do_not_optimize(head);
+}
+
+void string_map()
+{
+    std::map<std::string, int> m;
+    for (int i = 0; i < 100; ++i)
+    {
+        m["a key long enough to allocate " + std::to_string(i)] = i;
+    }
+    do_not_optimize(m.size());
+}
+
+void vector_growth()
+{
+    std::vector<int> v;
+    for (int i = 0; i < 1000; ++i)
+    {
+        v.push_back(i);
+    }
+    do_not_optimize(v.data());
+}
+
+template<class F>
+void run(const char* name, F f)
+{
+    // The best of several runs, as the times vary a lot from run to run.
+    double best = time_per_call_ns(f, 100);
+    for (int i = 0; i < 4; ++i)
+    {
+        best = std::min(best, time_per_call_ns(f, 100));
+    }
+    std::cout << "  " << name << ": " << best << " ns";
+#ifdef ALLOC_PROFILE
+    auto before = allocprof::thread_counters();
+    f();
+    auto used = allocprof::thread_counters() - before;
+    std::cout << ", " << used.allocations << " allocations of " << used.bytes_allocated << " bytes";
+#endif
+    std::cout << "\n";
+}
+
+int main()
+{
+#if defined(ALLOC_PROFILE) && defined(ALLOCPROF_SITES)
+    std::cout << "With the allocation profiler, counting sites:\n";
+#elif defined(ALLOC_PROFILE)
+    std::cout << "With the allocation profiler:\n";
+#else
+    std::cout << "Without the allocation profiler:\n";
+#endif
+    run("new and delete     ", new_delete);
+    run("shared_ptr chain   ", shared_ptr_chain);
+    run("map of strings     ", string_map);
+    run("vector push_back   ", vector_growth);
+}
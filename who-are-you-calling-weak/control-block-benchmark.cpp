@@ -0,0 +1,245 @@
+#include "pool-allocator.ipp"
+#include "timing.ipp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Compares the ways of creating a shared_ptr<DataHolder> that the examples
+// show, for choosing a policy for object caches:
+//
+//   shared_ptr(new)       - the object and the control block allocated apart
+//   make_shared           - one allocation holding both
+//   allocate_shared       - the same, through std::allocator
+//   allocate_shared pool  - the same, with the PoolAllocator from
+//                           pool-allocator.ipp
+//
+// For each it measures the allocations per object, the bytes still held
+// when only weak_ptrs are left, the time to create and destroy objects, and
+// the time (and cache misses, where the processor's counters can be read)
+// to go through a large vector of them, in order and shuffled.
+//
+// Like common.ipp this replaces operator new and delete, but only counts.
+
+namespace counts
+{
+std::size_t allocations = 0;
+std::size_t live_bytes = 0;
+} // namespace counts
+
+// A header the size of the alignment malloc gives holds the size.
+constexpr std::size_t header_size = alignof(std::max_align_t);
+
+void* operator new(std::size_t sz)
+{
+    auto ptr = static_cast<char*>(std::malloc(sz + header_size));
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<std::size_t*>(ptr) = sz;
+    ++counts::allocations;
+    counts::live_bytes += sz;
+    return ptr + header_size;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+    auto iptr = static_cast<char*>(ptr) - header_size;
+    counts::live_bytes -= *reinterpret_cast<std::size_t*>(iptr);
+    std::free(iptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+// DataHolder from common.ipp, without the printing.
+struct DataHolder
+{
+    DataHolder()
+    : num(++dh)
+    {
+    }
+
+    int num;
+    int i[20];
+    static int dh;
+};
+int DataHolder::dh = 0;
+
+// Counts the last level cache misses of this thread with perf_event_open,
+// if the kernel and the processor allow it, which virtual machines often
+// don't.
+class CacheMisses
+{
+public:
+    CacheMisses()
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    CacheMisses(const CacheMisses&) = delete;
+    CacheMisses& operator=(const CacheMisses&) = delete;
+
+    ~CacheMisses()
+    {
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+    }
+
+    bool available() const { return fd_ >= 0; }
+
+    long long read() const
+    {
+        long long count = 0;
+        if (fd_ < 0 || ::read(fd_, &count, sizeof(count)) != sizeof(count))
+        {
+            return -1;
+        }
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+constexpr std::size_t batch = 10'000;
+constexpr std::size_t lingering = 100'000;
+constexpr std::size_t large = 500'000;
+
+// Time f, and count the cache misses of one more call of it.
+template<class F>
+void show_time(const char* what, F f)
+{
+    std::cout << what << time_per_call_ns(f) / large << " ns per object";
+    static CacheMisses misses;
+    if (misses.available())
+    {
+        auto before = misses.read();
+        f();
+        std::cout << ", " << static_cast<double>(misses.read() - before) / large << " misses";
+    }
+}
+
+template<class Make>
+void measure(const char* name, Make make, bool pooled = false)
+{
+    std::cout << name << ":\n";
+    make();
+
+    auto allocations = counts::allocations;
+    auto bytes = counts::live_bytes;
+    auto in_use = pool::stats().bytes_in_use;
+    {
+        auto p = make();
+        std::cout << "  allocations per object: " << counts::allocations - allocations << ", "
+                  << counts::live_bytes - bytes + pool::stats().bytes_in_use - in_use << " bytes\n";
+    }
+
+    // Only weak_ptrs left: how much of each object is still held?
+    {
+        in_use = pool::stats().bytes_in_use;
+        std::vector<std::weak_ptr<DataHolder>> weak;
+        weak.reserve(lingering);
+        auto reserved = counts::live_bytes;
+        for (std::size_t i = 0; i < lingering; ++i)
+        {
+            weak.push_back(make());
+        }
+        auto held = counts::live_bytes - reserved;
+        if (pooled)
+        {
+            // Count the blocks rather than the chunks holding them.
+            held = pool::stats().bytes_in_use - in_use;
+        }
+        std::cout << "  held by a weak_ptr after the object is destroyed: "
+                  << static_cast<double>(held) / lingering << " bytes\n";
+    }
+
+    double ns = time_per_call_ns([&] {
+        std::vector<std::shared_ptr<DataHolder>> v;
+        v.reserve(batch);
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            v.push_back(make());
+        }
+        do_not_optimize(v.data());
+    });
+    std::cout << "  create and destroy: " << ns / batch << " ns per object\n";
+
+    std::vector<std::shared_ptr<DataHolder>> v;
+    v.reserve(large);
+    for (std::size_t i = 0; i < large; ++i)
+    {
+        v.push_back(make());
+    }
+    auto read_all = [&] {
+        long sum = 0;
+        for (const auto& p: v)
+        {
+            sum += p->num;
+        }
+        do_not_optimize(sum);
+    };
+    // Copying each shared_ptr touches the control block as well.
+    auto copy_all = [&] {
+        long sum = 0;
+        for (const auto& p: v)
+        {
+            auto copy = p;
+            do_not_optimize(copy);
+            sum += copy->num;
+        }
+        do_not_optimize(sum);
+    };
+    for (const char* order: {"in order", "shuffled"})
+    {
+        if (order[0] == 's')
+        {
+            std::shuffle(v.begin(), v.end(), std::mt19937_64(42));
+        }
+        std::cout << "  " << order << ": ";
+        show_time("read ", read_all);
+        show_time("; copy ", copy_all);
+        std::cout << "\n";
+    }
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(1);
+    if (!CacheMisses().available())
+    {
+        std::cout << "(The cache miss counters can't be read here, so only times are shown.)\n\n";
+    }
+
+    measure("shared_ptr(new)", [] { return std::shared_ptr<DataHolder>(new DataHolder); });
+    measure("make_shared", [] { return std::make_shared<DataHolder>(); });
+    measure("allocate_shared", [] { return std::allocate_shared<DataHolder>(std::allocator<DataHolder>()); });
+    measure(
+        "allocate_shared pool",
+        [] { return std::allocate_shared<DataHolder>(pool::PoolAllocator<DataHolder>()); }, true);
+}
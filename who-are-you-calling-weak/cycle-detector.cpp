@@ -0,0 +1,51 @@
+#include "common.ipp"
+#include "cycle-detector.ipp"
+#include <memory>
+
+struct Node
+{
+    template<class Visitor>
+    void traverse(Visitor& v) const
+    {
+        v(next);
+        v(back);
+    }
+
+    DataHolder data;
+    std::shared_ptr<Node> next;
+    std::weak_ptr<Node> back;
+};
+
+void report()
+{
+    auto snapshot = tracking::Tracker::instance().snapshot();
+    auto report = tracking::analyse(snapshot);
+    std::cout << LINENO << "Report: ";
+    tracking::print_report(std::cout, snapshot, report);
+}
+
+int main()
+{
+    std::cout << LINENO << "Creating parent and child, the child pointing back with a weak_ptr\n";
+    auto parent = tracking::make_tracked<Node>(TRACK_SITE);
+    parent->next = tracking::make_tracked<Node>(TRACK_SITE);
+    parent->next->back = parent;
+    report();
+
+    {
+        std::cout << LINENO << "Creating two nodes pointing at each other with shared_ptrs\n";
+        auto first = tracking::make_tracked<Node>(TRACK_SITE);
+        first->next = tracking::make_tracked<Node>(TRACK_SITE);
+        first->next->next = first;
+        report();
+        std::cout << LINENO << "Dropping the last outside reference to them\n";
+    }
+    report();
+
+    std::cout << LINENO << "Keeping a weak_ptr to the child and dropping the parent\n";
+    std::weak_ptr<Node> child = parent->next;
+    parent.reset();
+    report();
+
+    std::cout << LINENO << "Exiting program\n";
+}
@@ -0,0 +1,509 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// An opt-in tracker for objects owned by shared_ptr, to find reference cycles
+// that weak_ptr should have broken.
+//
+// Objects created with make_tracked<T>(TRACK_SITE, args...) are allocated
+// with allocate_shared using a TrackingAllocator, which tells the tracker the
+// size of the block holding the control block and the object, when the object
+// is destroyed, and when the block is freed. The tracker keeps a weak_ptr to
+// each live object so it can read its use_count, and drops it as soon as the
+// object is destroyed so it never keeps a block alive itself.
+//
+// A type takes part in cycle detection by providing a member function
+//
+//     template<class Visitor> void traverse(Visitor& v) const
+//
+// that calls v(p) for every shared_ptr or weak_ptr member p. A snapshot then
+// works out which objects are only owned by other tracked objects, using the
+// same approach as Python's cycle collector: start each object's count of
+// external owners at its use_count, subtract one for every shared_ptr to it
+// held by another tracked object, and treat every object left with a count
+// above zero as a root. Anything that can't be reached from a root is leaked,
+// and the strongly connected groups of leaked objects are the cycles keeping
+// it alive.
+//
+// The tracker's own data is allocated with malloc, so it doesn't appear in
+// the output of the operator new in common.ipp. A snapshot takes a lock that
+// stops tracked objects being destroyed, but other changes to the objects
+// while it runs will make the results approximate. The same lock is taken
+// four times for each tracked object, so threads creating and destroying
+// tracked objects at once wait for each other; cycle-detector-overhead.cpp
+// shows how much that costs.
+
+namespace tracking
+{
+
+// Allocator for the tracker's own data, using malloc and free directly.
+template<class T>
+struct MallocAllocator
+{
+    using value_type = T;
+
+    MallocAllocator() = default;
+    template<class U>
+    MallocAllocator(const MallocAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        if (auto p = std::malloc(n * sizeof(T)))
+        {
+            return static_cast<T*>(p);
+        }
+        throw std::bad_alloc();
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        std::free(p);
+    }
+
+    template<class U>
+    bool operator==(const MallocAllocator<U>&) const noexcept { return true; }
+    template<class U>
+    bool operator!=(const MallocAllocator<U>&) const noexcept { return false; }
+};
+
+template<class T>
+using Vector = std::vector<T, MallocAllocator<T>>;
+
+// Where a tracked object was created.
+struct Site
+{
+    const char* file;
+    int line;
+
+    bool operator<(const Site& other) const
+    {
+        int c = std::strcmp(file, other.file);
+        return c < 0 || (c == 0 && line < other.line);
+    }
+};
+
+#define TRACK_SITE tracking::Site{__FILE__, __LINE__}
+
+// Collects the objects a tracked object refers to. Only shared_ptrs are
+// recorded, as weak_ptrs don't own anything.
+class Visitor
+{
+public:
+    template<class T>
+    void operator()(const std::shared_ptr<T>& p)
+    {
+        if (p)
+        {
+            targets.push_back(static_cast<const void*>(p.get()));
+        }
+    }
+
+    template<class T>
+    void operator()(const std::weak_ptr<T>&)
+    {
+    }
+
+    Vector<const void*> targets;
+};
+
+template<class T, class = void>
+struct has_traverse : std::false_type {};
+
+template<class T>
+struct has_traverse<T, std::void_t<decltype(std::declval<const T&>().traverse(std::declval<Visitor&>()))>>
+: std::true_type {};
+
+// What the tracker knows about one allocation.
+struct Entry
+{
+    Site site;
+    std::size_t bytes = 0;              // control block and object together
+    const void* object = nullptr;
+    bool alive = false;                 // object constructed and not yet destroyed
+    std::weak_ptr<const void> weak;     // only while alive, to read use_count
+    void (*traverse)(const void*, Visitor&) = nullptr;
+    Entry* prev = nullptr;              // list of all entries, in allocation order
+    Entry* next = nullptr;
+};
+
+struct Node
+{
+    const void* object;
+    Site site;
+    std::size_t bytes;
+    long use_count;
+    Vector<std::size_t> edges;          // indexes of the nodes this one owns
+};
+
+// The ownership graph of the live tracked objects at one point in time, and
+// the blocks whose objects have gone but whose memory is kept by a weak_ptr.
+struct Snapshot
+{
+    Vector<Node> nodes;
+    Vector<std::pair<Site, std::size_t>> dead_blocks;
+};
+
+struct SiteTotal
+{
+    std::size_t objects = 0;
+    std::size_t bytes = 0;
+};
+
+using SiteMap = std::map<Site, SiteTotal, std::less<Site>,
+                         MallocAllocator<std::pair<const Site, SiteTotal>>>;
+
+struct Report
+{
+    std::size_t live_objects = 0;
+    std::size_t live_bytes = 0;
+    Vector<Vector<std::size_t>> cycles; // node indexes of each cycle
+    Vector<std::size_t> leaked;         // every node not reachable from a root
+    SiteMap leaked_by_site;             // bytes held only by cycles
+    SiteMap dead_by_site;               // bytes of destroyed objects kept by weak_ptrs
+};
+
+class Tracker
+{
+public:
+    static Tracker& instance()
+    {
+        static Tracker tracker;
+        return tracker;
+    }
+
+    Entry* new_entry(Site site)
+    {
+        auto e = new (std::malloc(sizeof(Entry))) Entry;
+        e->site = site;
+        return e;
+    }
+
+    void allocated(Entry* e, std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        e->bytes = bytes;
+        e->prev = last_;
+        (last_ ? last_->next : first_) = e;
+        last_ = e;
+    }
+
+    template<class T>
+    void constructed(Entry* e, const std::shared_ptr<T>& p)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        e->object = static_cast<const void*>(p.get());
+        e->alive = true;
+        e->weak = std::shared_ptr<const void>(p, e->object);
+        if constexpr (has_traverse<T>::value)
+        {
+            e->traverse = [](const void* object, Visitor& v) {
+                static_cast<const T*>(object)->traverse(v);
+            };
+        }
+    }
+
+    // Called just before the object is destroyed. The tracker's weak_ptr is
+    // released here so it doesn't keep the block alive.
+    void destroying(Entry* e)
+    {
+        std::weak_ptr<const void> weak;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            e->alive = false;
+            weak.swap(e->weak);
+        }
+    }
+
+    void freed(Entry* e)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            (e->prev ? e->prev->next : first_) = e->next;
+            (e->next ? e->next->prev : last_) = e->prev;
+        }
+        discard(e);
+    }
+
+    // Throw away an entry that was never added, if the allocation failed.
+    void discard(Entry* e)
+    {
+        e->~Entry();
+        std::free(e);
+    }
+
+    Snapshot snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Snapshot s;
+        std::unordered_map<const void*, std::size_t, std::hash<const void*>,
+                           std::equal_to<const void*>,
+                           MallocAllocator<std::pair<const void* const, std::size_t>>> index;
+        for (auto e = first_; e; e = e->next)
+        {
+            if (e->alive)
+            {
+                index[e->object] = s.nodes.size();
+                s.nodes.push_back({e->object, e->site, e->bytes, e->weak.use_count(), {}});
+            }
+            else if (e->object)
+            {
+                s.dead_blocks.push_back({e->site, e->bytes});
+            }
+        }
+        for (auto e = first_; e; e = e->next)
+        {
+            if (e->alive && e->traverse)
+            {
+                Visitor v;
+                e->traverse(e->object, v);
+                auto& node = s.nodes[index[e->object]];
+                for (auto t: v.targets)
+                {
+                    auto found = index.find(t);
+                    if (found != index.end())
+                    {
+                        node.edges.push_back(found->second);
+                    }
+                }
+            }
+        }
+        return s;
+    }
+
+private:
+    Tracker() = default;
+
+    std::mutex mutex_;
+    Entry* first_ = nullptr;
+    Entry* last_ = nullptr;
+};
+
+// The allocator given to allocate_shared. All copies, including rebound ones,
+// share the entry for the one allocation they are used for.
+template<class T>
+struct TrackingAllocator
+{
+    using value_type = T;
+
+    explicit TrackingAllocator(Entry* e) noexcept : entry(e) {}
+    template<class U>
+    TrackingAllocator(const TrackingAllocator<U>& other) noexcept : entry(other.entry) {}
+
+    T* allocate(std::size_t n)
+    {
+        T* p;
+        try
+        {
+            p = static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        catch (...)
+        {
+            Tracker::instance().discard(entry);
+            throw;
+        }
+        Tracker::instance().allocated(entry, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        Tracker::instance().freed(entry);
+        ::operator delete(p);
+        (void)n;
+    }
+
+    template<class U>
+    void destroy(U* p)
+    {
+        Tracker::instance().destroying(entry);
+        p->~U();
+    }
+
+    template<class U>
+    bool operator==(const TrackingAllocator<U>& other) const noexcept { return entry == other.entry; }
+    template<class U>
+    bool operator!=(const TrackingAllocator<U>& other) const noexcept { return entry != other.entry; }
+
+    Entry* entry;
+};
+
+template<class T, class... Args>
+std::shared_ptr<T> make_tracked(Site site, Args&&... args)
+{
+    auto& tracker = Tracker::instance();
+    auto entry = tracker.new_entry(site);
+    auto p = std::allocate_shared<T>(TrackingAllocator<T>(entry), std::forward<Args>(args)...);
+    tracker.constructed(entry, p);
+    return p;
+}
+
+// Work out which objects in a snapshot are leaked, and the cycles that are
+// keeping them alive.
+inline Report analyse(const Snapshot& s)
+{
+    Report r;
+    auto n = s.nodes.size();
+    r.live_objects = n;
+
+    Vector<long> external(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        external[i] = s.nodes[i].use_count;
+        r.live_bytes += s.nodes[i].bytes;
+    }
+    for (const auto& node: s.nodes)
+    {
+        for (auto e: node.edges)
+        {
+            --external[e];
+        }
+    }
+
+    // Mark everything reachable from the roots.
+    Vector<char> reached(n, 0);
+    Vector<std::size_t> stack;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (external[i] > 0 && !reached[i])
+        {
+            reached[i] = 1;
+            stack.push_back(i);
+            while (!stack.empty())
+            {
+                auto j = stack.back();
+                stack.pop_back();
+                for (auto e: s.nodes[j].edges)
+                {
+                    if (!reached[e])
+                    {
+                        reached[e] = 1;
+                        stack.push_back(e);
+                    }
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (!reached[i])
+        {
+            r.leaked.push_back(i);
+            auto& total = r.leaked_by_site[s.nodes[i].site];
+            ++total.objects;
+            total.bytes += s.nodes[i].bytes;
+        }
+    }
+    for (const auto& d: s.dead_blocks)
+    {
+        auto& total = r.dead_by_site[d.first];
+        ++total.objects;
+        total.bytes += d.second;
+    }
+
+    // Tarjan's algorithm, restricted to the leaked nodes, written without
+    // recursion so long chains can't overflow the stack. A component is a
+    // cycle if it has more than one node, or one node that owns itself.
+    const std::size_t none = static_cast<std::size_t>(-1);
+    Vector<std::size_t> order(n, none), low(n, 0);
+    Vector<char> on_stack(n, 0);
+    Vector<std::size_t> scc_stack;
+    Vector<std::pair<std::size_t, std::size_t>> work;   // node, next edge
+    std::size_t counter = 0;
+    for (auto start: r.leaked)
+    {
+        if (order[start] != none)
+        {
+            continue;
+        }
+        work.push_back({start, 0});
+        while (!work.empty())
+        {
+            auto& [v, next] = work.back();
+            if (next == 0 && order[v] == none)
+            {
+                order[v] = low[v] = counter++;
+                scc_stack.push_back(v);
+                on_stack[v] = 1;
+            }
+            const auto& edges = s.nodes[v].edges;
+            if (next < edges.size())
+            {
+                auto w = edges[next++];
+                if (reached[w])
+                {
+                    continue;
+                }
+                if (order[w] == none)
+                {
+                    work.push_back({w, 0});
+                }
+                else if (on_stack[w])
+                {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+            auto done = v;
+            work.pop_back();
+            if (!work.empty())
+            {
+                auto parent = work.back().first;
+                low[parent] = std::min(low[parent], low[done]);
+            }
+            if (low[done] == order[done])
+            {
+                Vector<std::size_t> component;
+                std::size_t w;
+                do
+                {
+                    w = scc_stack.back();
+                    scc_stack.pop_back();
+                    on_stack[w] = 0;
+                    component.push_back(w);
+                } while (w != done);
+                const auto& de = s.nodes[done].edges;
+                if (component.size() > 1 || std::find(de.begin(), de.end(), done) != de.end())
+                {
+                    r.cycles.push_back(std::move(component));
+                }
+            }
+        }
+    }
+    return r;
+}
+
+inline void print_report(std::ostream& out, const Snapshot& s, const Report& r)
+{
+    out << "Tracked objects: " << r.live_objects << " (" << r.live_bytes << " bytes), leaked: "
+        << r.leaked.size() << ", cycles: " << r.cycles.size() << "\n";
+    for (const auto& cycle: r.cycles)
+    {
+        out << "  Cycle of " << cycle.size() << " object(s):";
+        for (auto i: cycle)
+        {
+            out << " " << s.nodes[i].site.file << ":" << s.nodes[i].site.line;
+        }
+        out << "\n";
+    }
+    for (const auto& [site, total]: r.leaked_by_site)
+    {
+        out << "  Leaked " << total.bytes << " bytes in " << total.objects
+            << " object(s) created at " << site.file << ":" << site.line << "\n";
+    }
+    for (const auto& [site, total]: r.dead_by_site)
+    {
+        out << "  Weak references keep " << total.bytes << " bytes of " << total.objects
+            << " destroyed object(s) created at " << site.file << ":" << site.line << "\n";
+    }
+}
+
+} // namespace tracking
@@ -0,0 +1,114 @@
+#include "local-ptr.ipp"
+#include "timing.ipp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Copying and destroying the pointers in local-ptr.ipp against
+// std::shared_ptr, on one thread and on several, each with objects of its
+// own. The last line for several threads has them all copy the same
+// std::shared_ptr, which the local pointers don't allow, for comparison.
+
+struct DataHolder
+{
+    int num = 0;
+    int i[20];
+};
+
+struct CountedDataHolder : DataHolder, local::RefCounted<CountedDataHolder>
+{
+};
+
+constexpr int copies = 1'000;
+
+// Copy p and destroy the copy, copies times.
+template<class Ptr>
+void copy_and_destroy(const Ptr& p)
+{
+    for (int i = 0; i < copies; ++i)
+    {
+        Ptr copy = p;
+        do_not_optimize(copy);
+    }
+}
+
+// Lock w and destroy what it gives, copies times.
+template<class Weak>
+void lock_weak(const Weak& w)
+{
+    for (int i = 0; i < copies; ++i)
+    {
+        auto p = w.lock();
+        do_not_optimize(p);
+    }
+}
+
+// Time f run on threads threads at once, and return the time per copy for
+// each thread. make gives each thread the state f is called with.
+template<class Make, class F>
+double on_threads(int threads, Make make, F f)
+{
+    if (threads == 1)
+    {
+        auto state = make();
+        return time_per_call_ns([&] { f(state); }) / copies;
+    }
+    constexpr int calls = 20'000;
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&] {
+            auto state = make();
+            for (int i = 0; i < calls; ++i)
+            {
+                f(state);
+            }
+        });
+    }
+    for (auto& w: workers)
+    {
+        w.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / (static_cast<double>(calls) * copies);
+}
+
+int main()
+{
+    int threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+    auto std_ptr = [] { return std::make_shared<DataHolder>(); };
+    auto local_ptr = [] { return local::make_local_shared<DataHolder>(); };
+    auto intrusive = [] { return local::make_intrusive<CountedDataHolder>(); };
+    // Each holds a strong pointer to keep the object alive, and a weak one.
+    auto std_weak = [] {
+        auto p = std::make_shared<DataHolder>();
+        return std::make_pair(p, std::weak_ptr<DataHolder>(p));
+    };
+    auto local_weak = [] {
+        auto p = local::make_local_shared<DataHolder>();
+        return std::make_pair(p, local::local_weak_ptr<DataHolder>(p));
+    };
+    auto lock = [](const auto& state) { lock_weak(state.second); };
+    auto copy = [](const auto& p) { copy_and_destroy(p); };
+
+    std::cout << "Copy and destroy, per copy:\n";
+    for (int t: {1, threads})
+    {
+        std::cout << "  " << t << " thread(s):\n";
+        std::cout << "    std::shared_ptr           " << on_threads(t, std_ptr, copy) << " ns\n";
+        std::cout << "    local_shared_ptr          " << on_threads(t, local_ptr, copy) << " ns\n";
+        std::cout << "    intrusive_ptr             " << on_threads(t, intrusive, copy) << " ns\n";
+        std::cout << "    std::weak_ptr lock        " << on_threads(t, std_weak, lock) << " ns\n";
+        std::cout << "    local_weak_ptr lock       " << on_threads(t, local_weak, lock) << " ns\n";
+        if (t > 1)
+        {
+            auto shared = std::make_shared<DataHolder>();
+            std::cout << "    std::shared_ptr, shared   "
+                      << on_threads(t, [&] { return shared; }, copy) << " ns\n";
+        }
+    }
+}
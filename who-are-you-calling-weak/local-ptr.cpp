@@ -0,0 +1,40 @@
+#include "common.ipp"
+#include "local-ptr.ipp"
+
+struct CountedDataHolder : DataHolder, local::RefCounted<CountedDataHolder>
+{
+};
+
+int main()
+{
+    local::local_weak_ptr<DataHolder> wp1;
+    {
+        std::cout << LINENO << "Creating local_shared_ptr from pointer\n";
+        auto p1 = local::local_shared_ptr<DataHolder>{new DataHolder};
+        std::cout << LINENO << "Finished creating from pointer, use_count=" << p1.use_count() << ", object @ " << std::hex << p1.get() << std::dec << "\n";
+        std::cout << LINENO << "Assigning to local_weak_ptr\n";
+        wp1 = p1;
+        std::cout << LINENO << "After assigning to local_weak_ptr, use_count=" << p1.use_count() << "\n";
+    }
+    std::cout << LINENO << "After the local_shared_ptr has gone, expired=" << wp1.expired() << "\n";
+
+    local::local_weak_ptr<DataHolder> wp2;
+    {
+        std::cout << LINENO << "Creating with make_local_shared\n";
+        auto p2 = local::make_local_shared<DataHolder>();
+        std::cout << LINENO << "Finished creating with make_local_shared, use_count=" << p2.use_count() << ", object @ " << std::hex << p2.get() << std::dec << "\n";
+        std::cout << LINENO << "Assigning to local_weak_ptr\n";
+        wp2 = p2;
+        std::cout << LINENO << "After assigning to local_weak_ptr, use_count=" << p2.use_count() << "\n";
+    }
+    std::cout << LINENO << "After the local_shared_ptr has gone, expired=" << wp2.expired() << "\n";
+
+    {
+        std::cout << LINENO << "Creating intrusive_ptr\n";
+        auto p3 = local::make_intrusive<CountedDataHolder>();
+        std::cout << LINENO << "Finished creating intrusive_ptr, use_count=" << p3->use_count() << ", object @ " << std::hex << p3.get() << std::dec << "\n";
+        auto copy = p3;
+        std::cout << LINENO << "After copying, use_count=" << p3->use_count() << "\n";
+    }
+    std::cout << LINENO << "Exiting program\n";
+}
@@ -0,0 +1,433 @@
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Smart pointers for objects that never leave the thread that made them,
+// where the atomic updates of std::shared_ptr's counts cost time for nothing.
+// (libstdc++ only uses plain updates when the program doesn't use threads
+// at all, and since glibc 2.34 every program counts as using them.)
+//
+//   intrusive_ptr<T>     - for types that hold their own count, such as ones
+//                          derived from RefCounted<T>. There is no control
+//                          block, so no weak pointer, and the object is freed
+//                          as soon as the last intrusive_ptr to it goes.
+//   local_shared_ptr<T>  - like std::shared_ptr, with the same control block
+//                          and use and weak counts, but the counts are plain
+//                          integers
+//   local_weak_ptr<T>    - the weak_ptr for local_shared_ptr
+//
+// local_shared_ptr keeps the lifetimes the examples show for shared_ptr. Made
+// from a pointer, the object and the control block are allocated separately,
+// and the object is freed when the last local_shared_ptr goes, while the
+// control block stays until the last local_weak_ptr goes too. Made with
+// make_local_shared, the two share one allocation, which isn't freed until
+// the last local_weak_ptr goes, though the object is destroyed before that.
+//
+// None of these may be copied, or the object destroyed, by more than one
+// thread. Moving a pointer to another thread, and using it only there, is
+// fine.
+
+namespace local
+{
+
+namespace detail
+{
+
+class ControlBlock
+{
+public:
+    void add_use() noexcept { ++uses_; }
+    void add_weak() noexcept { ++weaks_; }
+
+    // The local_shared_ptrs together hold one weak count, given up when the
+    // object is destroyed.
+    void release_use() noexcept
+    {
+        if (--uses_ == 0)
+        {
+            destroy_object();
+            release_weak();
+        }
+    }
+
+    void release_weak() noexcept
+    {
+        if (--weaks_ == 0)
+        {
+            free_block();
+        }
+    }
+
+    long use_count() const noexcept { return uses_; }
+
+protected:
+    ControlBlock() = default;
+    ~ControlBlock() = default;
+
+private:
+    virtual void destroy_object() noexcept = 0;
+    virtual void free_block() noexcept = 0;
+
+    // int, as in libstdc++, so the blocks are the same size as its ones.
+    int uses_ = 1;
+    int weaks_ = 1;
+};
+
+// For an object made separately, and freed with a deleter.
+template<class T, class Deleter>
+class PointerBlock final : public ControlBlock
+{
+public:
+    PointerBlock(T* p, Deleter d)
+    : ptr_(p),
+      deleter_(std::move(d))
+    {
+    }
+
+private:
+    void destroy_object() noexcept override { deleter_(ptr_); }
+    void free_block() noexcept override { delete this; }
+
+    T* ptr_;
+    Deleter deleter_;
+};
+
+// Without space for a deleter that holds nothing.
+template<class T>
+class PointerBlock<T, std::default_delete<T>> final : public ControlBlock
+{
+public:
+    PointerBlock(T* p, std::default_delete<T>)
+    : ptr_(p)
+    {
+    }
+
+private:
+    void destroy_object() noexcept override { delete ptr_; }
+    void free_block() noexcept override { delete this; }
+
+    T* ptr_;
+};
+
+// For an object in the same allocation as the control block.
+template<class T>
+class InplaceBlock final : public ControlBlock
+{
+public:
+    template<class... Args>
+    explicit InplaceBlock(Args&&... args)
+    {
+        ::new (static_cast<void*>(storage_)) T(std::forward<Args>(args)...);
+    }
+
+    T* get() noexcept { return std::launder(reinterpret_cast<T*>(storage_)); }
+
+private:
+    void destroy_object() noexcept override { get()->~T(); }
+    void free_block() noexcept override { delete this; }
+
+    alignas(T) unsigned char storage_[sizeof(T)];
+};
+
+// Tags the constructor that takes over a use count already added.
+struct Adopt
+{
+};
+
+} // namespace detail
+
+// A base for types counted by intrusive_ptr. The count isn't copied with the
+// object.
+template<class Derived>
+class RefCounted
+{
+public:
+    long use_count() const noexcept { return refs_; }
+
+protected:
+    RefCounted() = default;
+    RefCounted(const RefCounted&) noexcept {}
+    RefCounted& operator=(const RefCounted&) noexcept { return *this; }
+    ~RefCounted() = default;
+
+private:
+    friend void intrusive_add_ref(const RefCounted* p) noexcept { ++p->refs_; }
+
+    friend void intrusive_release(const RefCounted* p) noexcept
+    {
+        if (--p->refs_ == 0)
+        {
+            delete static_cast<const Derived*>(p);
+        }
+    }
+
+    mutable long refs_ = 0;
+};
+
+// Holds a T* counted by the functions intrusive_add_ref(T*) and
+// intrusive_release(T*), found by argument dependent lookup, as with
+// boost::intrusive_ptr.
+template<class T>
+class intrusive_ptr
+{
+public:
+    using element_type = T;
+
+    intrusive_ptr() noexcept = default;
+
+    intrusive_ptr(T* p) noexcept
+    : ptr_(p)
+    {
+        if (ptr_)
+        {
+            intrusive_add_ref(ptr_);
+        }
+    }
+
+    intrusive_ptr(const intrusive_ptr& other) noexcept
+    : intrusive_ptr(other.ptr_)
+    {
+    }
+
+    intrusive_ptr(intrusive_ptr&& other) noexcept
+    : ptr_(std::exchange(other.ptr_, nullptr))
+    {
+    }
+
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    intrusive_ptr(const intrusive_ptr<U>& other) noexcept
+    : intrusive_ptr(other.get())
+    {
+    }
+
+    ~intrusive_ptr()
+    {
+        if (ptr_)
+        {
+            intrusive_release(ptr_);
+        }
+    }
+
+    intrusive_ptr& operator=(intrusive_ptr other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void reset(T* p = nullptr) noexcept { intrusive_ptr(p).swap(*this); }
+    void swap(intrusive_ptr& other) noexcept { std::swap(ptr_, other.ptr_); }
+
+    T* get() const noexcept { return ptr_; }
+    T& operator*() const noexcept { return *ptr_; }
+    T* operator->() const noexcept { return ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+private:
+    T* ptr_ = nullptr;
+};
+
+template<class T, class... Args>
+intrusive_ptr<T> make_intrusive(Args&&... args)
+{
+    return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+template<class T>
+class local_weak_ptr;
+
+template<class T>
+class local_shared_ptr
+{
+public:
+    using element_type = T;
+
+    local_shared_ptr() noexcept = default;
+    local_shared_ptr(std::nullptr_t) noexcept {}
+
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    explicit local_shared_ptr(U* p)
+    : local_shared_ptr(p, std::default_delete<U>())
+    {
+    }
+
+    template<class U, class Deleter, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    local_shared_ptr(U* p, Deleter d)
+    : ptr_(p)
+    {
+        try
+        {
+            block_ = new detail::PointerBlock<U, Deleter>(p, d);
+        }
+        catch (...)
+        {
+            d(p);
+            throw;
+        }
+    }
+
+    local_shared_ptr(const local_shared_ptr& other) noexcept
+    : ptr_(other.ptr_),
+      block_(other.block_)
+    {
+        if (block_)
+        {
+            block_->add_use();
+        }
+    }
+
+    local_shared_ptr(local_shared_ptr&& other) noexcept
+    : ptr_(std::exchange(other.ptr_, nullptr)),
+      block_(std::exchange(other.block_, nullptr))
+    {
+    }
+
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    local_shared_ptr(const local_shared_ptr<U>& other) noexcept
+    : ptr_(other.ptr_),
+      block_(other.block_)
+    {
+        if (block_)
+        {
+            block_->add_use();
+        }
+    }
+
+    ~local_shared_ptr()
+    {
+        if (block_)
+        {
+            block_->release_use();
+        }
+    }
+
+    local_shared_ptr& operator=(local_shared_ptr other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void reset() noexcept { local_shared_ptr().swap(*this); }
+
+    template<class U>
+    void reset(U* p)
+    {
+        local_shared_ptr(p).swap(*this);
+    }
+
+    void swap(local_shared_ptr& other) noexcept
+    {
+        std::swap(ptr_, other.ptr_);
+        std::swap(block_, other.block_);
+    }
+
+    T* get() const noexcept { return ptr_; }
+    T& operator*() const noexcept { return *ptr_; }
+    T* operator->() const noexcept { return ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+    long use_count() const noexcept { return block_ ? block_->use_count() : 0; }
+
+private:
+    template<class U>
+    friend class local_shared_ptr;
+    template<class U>
+    friend class local_weak_ptr;
+    template<class U, class... Args>
+    friend local_shared_ptr<U> make_local_shared(Args&&... args);
+
+    local_shared_ptr(detail::Adopt, T* p, detail::ControlBlock* block) noexcept
+    : ptr_(p),
+      block_(block)
+    {
+    }
+
+    T* ptr_ = nullptr;
+    detail::ControlBlock* block_ = nullptr;
+};
+
+// Make the object and its control block in one allocation, as make_shared
+// does.
+template<class T, class... Args>
+local_shared_ptr<T> make_local_shared(Args&&... args)
+{
+    auto block = new detail::InplaceBlock<T>(std::forward<Args>(args)...);
+    return local_shared_ptr<T>(detail::Adopt(), block->get(), block);
+}
+
+template<class T>
+class local_weak_ptr
+{
+public:
+    using element_type = T;
+
+    local_weak_ptr() noexcept = default;
+
+    template<class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    local_weak_ptr(const local_shared_ptr<U>& p) noexcept
+    : ptr_(p.ptr_),
+      block_(p.block_)
+    {
+        if (block_)
+        {
+            block_->add_weak();
+        }
+    }
+
+    local_weak_ptr(const local_weak_ptr& other) noexcept
+    : ptr_(other.ptr_),
+      block_(other.block_)
+    {
+        if (block_)
+        {
+            block_->add_weak();
+        }
+    }
+
+    local_weak_ptr(local_weak_ptr&& other) noexcept
+    : ptr_(std::exchange(other.ptr_, nullptr)),
+      block_(std::exchange(other.block_, nullptr))
+    {
+    }
+
+    ~local_weak_ptr()
+    {
+        if (block_)
+        {
+            block_->release_weak();
+        }
+    }
+
+    local_weak_ptr& operator=(local_weak_ptr other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void reset() noexcept { local_weak_ptr().swap(*this); }
+
+    void swap(local_weak_ptr& other) noexcept
+    {
+        std::swap(ptr_, other.ptr_);
+        std::swap(block_, other.block_);
+    }
+
+    long use_count() const noexcept { return block_ ? block_->use_count() : 0; }
+    bool expired() const noexcept { return use_count() == 0; }
+
+    local_shared_ptr<T> lock() const noexcept
+    {
+        if (expired())
+        {
+            return nullptr;
+        }
+        block_->add_use();
+        return local_shared_ptr<T>(detail::Adopt(), ptr_, block_);
+    }
+
+private:
+    T* ptr_ = nullptr;
+    detail::ControlBlock* block_ = nullptr;
+};
+
+} // namespace local
@@ -0,0 +1,106 @@
+#include "pool-allocator.ipp"
+#include "timing.ipp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// The allocators in pool-allocator.ipp against operator new, which is what
+// make_shared and the containers use in Output-2.txt and Output-4.txt. This
+// doesn't include common.ipp, so allocations aren't printed.
+
+struct DataHolder
+{
+    int num = 0;
+    int i[20];
+};
+
+constexpr std::size_t batch = 1'000;
+
+// Create a batch of objects, then destroy them, so the allocator has to
+// find space for a batch rather than reusing the block just freed.
+template<class Make>
+void create_batch(Make make)
+{
+    std::vector<std::shared_ptr<DataHolder>> v;
+    v.reserve(batch);
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+        v.push_back(make());
+    }
+    do_not_optimize(v.data());
+}
+
+auto with_make_shared = [] { return std::make_shared<DataHolder>(); };
+auto with_pool = [] { return std::allocate_shared<DataHolder>(pool::PoolAllocator<DataHolder>()); };
+
+template<class Alloc>
+void fill_list(const Alloc& alloc)
+{
+    std::list<DataHolder, Alloc> l(alloc);
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+        l.emplace_back();
+    }
+    do_not_optimize(l.back());
+}
+
+// Time f run on threads threads at once, and return the time per object for
+// each thread.
+template<class F>
+double on_threads(int threads, F f)
+{
+    if (threads == 1)
+    {
+        return time_per_call_ns(f) / batch;
+    }
+    constexpr int calls = 2'000;
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&] {
+            for (int i = 0; i < calls; ++i)
+            {
+                f();
+            }
+        });
+    }
+    for (auto& w: workers)
+    {
+        w.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / (static_cast<double>(calls) * batch);
+}
+
+int main()
+{
+    int threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+    std::cout << "Create and destroy objects in batches of " << batch << ", per object:\n";
+    for (int t: {1, threads})
+    {
+        std::cout << "  " << t << " thread(s):\n";
+        std::cout << "    make_shared               "
+                  << on_threads(t, [] { create_batch(with_make_shared); }) << " ns\n";
+        std::cout << "    allocate_shared pool      " << on_threads(t, [] { create_batch(with_pool); })
+                  << " ns\n";
+    }
+
+    std::cout << "Fill a list of DataHolders and destroy it, per element:\n";
+    std::cout << "  std::allocator            "
+              << time_per_call_ns([] { fill_list(std::allocator<DataHolder>()); }) / batch << " ns\n";
+    std::cout << "  PoolAllocator             "
+              << time_per_call_ns([] { fill_list(pool::PoolAllocator<DataHolder>()); }) / batch << " ns\n";
+    std::cout << "  ArenaAllocator            " << time_per_call_ns([] {
+        pool::Arena arena;
+        fill_list(pool::ArenaAllocator<DataHolder>(arena));
+    }) / batch << " ns\n";
+
+    auto s = pool::stats();
+    std::cout << "Pool blocks still in use: " << s.blocks_in_use << ", memory reserved: " << s.bytes_reserved
+              << " bytes\n";
+}
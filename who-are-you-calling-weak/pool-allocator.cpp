@@ -0,0 +1,73 @@
+#include "common.ipp"
+#include "pool-allocator.ipp"
+#include <list>
+#include <memory>
+#include <thread>
+#include <vector>
+
+void report(const char* when)
+{
+    auto s = pool::stats();
+    std::cout << LINENO << when << ", pool blocks in use=" << s.blocks_in_use << " (" << s.bytes_in_use
+              << " bytes)\n";
+}
+
+// The same size as DataHolder, so from the same pool, but without the output.
+struct Quiet
+{
+    int i[21];
+};
+
+// Made before the thread's pool cache, so destroyed after it, and its blocks
+// freed once the cache has gone.
+thread_local std::vector<std::shared_ptr<DataHolder>> held_by_thread;
+
+int main()
+{
+    std::weak_ptr<DataHolder> wp;
+    {
+        std::cout << LINENO << "Creating with allocate_shared and a PoolAllocator\n";
+        auto p = std::allocate_shared<DataHolder>(pool::PoolAllocator<DataHolder>());
+        report("Finished creating");
+        std::cout << LINENO << "Assigning to weak_ptr\n";
+        wp = p;
+    }
+    report("After the shared_ptr has gone");
+    wp.reset();
+    report("After the weak_ptr has gone");
+
+    {
+        std::cout << LINENO << "Creating a list of two DataHolders with a PoolAllocator\n";
+        std::list<DataHolder, pool::PoolAllocator<DataHolder>> l(2);
+        report("Finished creating");
+    }
+    report("After the list has gone");
+
+    {
+        pool::Arena arena;
+        std::cout << LINENO << "Creating with allocate_shared and an ArenaAllocator\n";
+        auto p = std::allocate_shared<DataHolder>(pool::ArenaAllocator<DataHolder>(arena));
+        wp = p;
+        p.reset();
+        wp.reset();
+        std::cout << LINENO << "After the shared_ptr and weak_ptr have gone, arena bytes in use="
+                  << arena.bytes_used() << "\n";
+        std::cout << LINENO << "Destroying the arena\n";
+    }
+    {
+        std::cout << LINENO << "Starting a thread that keeps two DataHolders in a thread_local vector\n";
+        std::thread([] {
+            held_by_thread.reserve(2);
+            for (int i = 0; i < 2; ++i)
+            {
+                held_by_thread.push_back(std::allocate_shared<DataHolder>(pool::PoolAllocator<DataHolder>()));
+            }
+            for (int i = 0; i < 70; ++i)
+            {
+                auto p = std::allocate_shared<Quiet>(pool::PoolAllocator<Quiet>());
+            }
+        }).join();
+        report("After the thread has exited");
+    }
+    std::cout << LINENO << "Exiting program\n";
+}
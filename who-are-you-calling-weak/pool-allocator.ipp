@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Allocators for objects like DataHolder that are all the same size, to use
+// in place of operator new with allocate_shared, std::vector and the node
+// based containers.
+//
+//   PoolAllocator<T>   - single objects come from a pool of blocks of one
+//                        size, shared by the whole program. Each thread keeps
+//                        a small cache of free blocks, so it only takes the
+//                        pool's lock once for a batch of allocations or
+//                        frees. Arrays, and types needing more alignment
+//                        than operator new gives, use operator new instead.
+//   ArenaAllocator<T>  - allocates from an Arena, a monotonic buffer that
+//                        hands out memory in order and never reuses it.
+//                        Deallocating does nothing; the arena's memory is
+//                        all freed at once by release() or its destructor.
+//
+// allocate_shared allocates the block holding the control block and the
+// object with a copy of the allocator rebound to a type of its own, and
+// frees it with that allocator once the last shared_ptr and weak_ptr to it
+// have gone. With a PoolAllocator the block goes back to the pool then, so a
+// lingering weak_ptr keeps a block of the pool in use, as it would keep
+// memory from operator new. With an ArenaAllocator nothing is freed until
+// the arena is.
+//
+//     auto p = std::allocate_shared<DataHolder>(pool::PoolAllocator<DataHolder>());
+//
+//     pool::Arena arena;
+//     std::vector<int, pool::ArenaAllocator<int>> v(pool::ArenaAllocator<int>(arena));
+//
+// pool::stats() gives the blocks in use and the memory reserved, over all
+// the pools, as the types allocate_shared allocates can't be named.
+//
+// The pools get memory from operator new in chunks, and never give it back:
+// each pool lasts until the program exits, so that blocks can be freed by
+// threads that are still running while it exits. Nothing else is allocated.
+
+namespace pool
+{
+
+// Blocks are a multiple of this in size, and aligned to it.
+constexpr std::size_t granularity = alignof(std::max_align_t);
+
+constexpr std::size_t block_size_for(std::size_t size)
+{
+    return (std::max(size, std::size_t{1}) + granularity - 1) / granularity * granularity;
+}
+
+namespace detail
+{
+
+struct Block
+{
+    Block* next;
+};
+
+class ThreadCache;
+class Central;
+
+// Every pool, for stats().
+struct Registry
+{
+    std::mutex mutex;
+    Central* pools = nullptr;
+};
+
+inline Registry& registry()
+{
+    alignas(Registry) static unsigned char storage[sizeof(Registry)];
+    static auto r = new (storage) Registry;
+    return *r;
+}
+
+// The blocks of one size not held by a thread's cache.
+class Central
+{
+public:
+    explicit Central(std::size_t block_size)
+    : block_size_(block_size),
+      blocks_per_chunk_(std::max<std::size_t>(64, (std::size_t{64} << 10) / block_size))
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        next_pool = r.pools;
+        r.pools = this;
+    }
+
+    // Take n blocks, linked together.
+    Block* take(std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (free_count_ < n)
+        {
+            add_chunk();
+        }
+        Block* head = free_;
+        Block* tail = head;
+        for (std::size_t i = 1; i < n; ++i)
+        {
+            tail = tail->next;
+        }
+        free_ = tail->next;
+        tail->next = nullptr;
+        free_count_ -= n;
+        return head;
+    }
+
+    // Give back the n blocks linked from head to tail.
+    void give(Block* head, Block* tail, std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tail->next = free_;
+        free_ = head;
+        free_count_ += n;
+    }
+
+    void attach(ThreadCache* cache);
+    void detach(ThreadCache* cache);
+    std::size_t blocks_in_use();
+
+    std::size_t block_size() const { return block_size_; }
+
+    std::size_t bytes_reserved()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return chunks_ * blocks_per_chunk_ * block_size_;
+    }
+
+    Central* next_pool = nullptr;
+
+private:
+    void add_chunk()
+    {
+        auto chunk = static_cast<char*>(::operator new(blocks_per_chunk_ * block_size_));
+        for (std::size_t i = blocks_per_chunk_; i-- > 0;)
+        {
+            auto block = reinterpret_cast<Block*>(chunk + i * block_size_);
+            block->next = free_;
+            free_ = block;
+        }
+        free_count_ += blocks_per_chunk_;
+        ++chunks_;
+    }
+
+    std::mutex mutex_;
+    const std::size_t block_size_;
+    const std::size_t blocks_per_chunk_;
+    Block* free_ = nullptr;
+    std::size_t free_count_ = 0;
+    std::size_t chunks_ = 0;
+    ThreadCache* caches_ = nullptr;
+};
+
+// A thread's free blocks of one size. It takes a batch from the central list
+// when it runs out, and gives a batch back when it has two spare, so a thread
+// that only frees, or only allocates, doesn't keep blocks from the others.
+// What it holds is given back when the thread exits.
+class ThreadCache
+{
+public:
+    // finished is set when the cache is destroyed.
+    ThreadCache(Central& central, bool& finished)
+    : central_(central),
+      batch_(std::max<std::size_t>(8, 4096 / central.block_size())),
+      finished_(finished)
+    {
+        central_.attach(this);
+    }
+
+    ThreadCache(const ThreadCache&) = delete;
+    ThreadCache& operator=(const ThreadCache&) = delete;
+
+    ~ThreadCache()
+    {
+        if (free_)
+        {
+            Block* tail = free_;
+            while (tail->next)
+            {
+                tail = tail->next;
+            }
+            central_.give(free_, tail, count());
+            free_ = nullptr;
+            set_count(0);
+        }
+        central_.detach(this);
+        finished_ = true;
+    }
+
+    void* allocate()
+    {
+        if (!free_)
+        {
+            free_ = central_.take(batch_);
+            set_count(batch_);
+        }
+        Block* block = free_;
+        free_ = block->next;
+        set_count(count() - 1);
+        return block;
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        auto block = static_cast<Block*>(p);
+        block->next = free_;
+        free_ = block;
+        set_count(count() + 1);
+        if (count() >= 2 * batch_)
+        {
+            Block* tail = free_;
+            for (std::size_t i = 1; i < batch_; ++i)
+            {
+                tail = tail->next;
+            }
+            Block* head = free_;
+            free_ = tail->next;
+            central_.give(head, tail, batch_);
+            set_count(count() - batch_);
+        }
+    }
+
+    // Only changed by the thread owning the cache, but read by others for
+    // blocks_in_use().
+    std::size_t count() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+    friend class Central;
+
+    void set_count(std::size_t n) { count_.store(n, std::memory_order_relaxed); }
+
+    Central& central_;
+    const std::size_t batch_;
+    bool& finished_;
+    Block* free_ = nullptr;
+    std::atomic<std::size_t> count_{0};
+    ThreadCache* prev_ = nullptr;
+    ThreadCache* next_ = nullptr;
+};
+
+inline void Central::attach(ThreadCache* cache)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache->next_ = caches_;
+    if (caches_)
+    {
+        caches_->prev_ = cache;
+    }
+    caches_ = cache;
+}
+
+inline void Central::detach(ThreadCache* cache)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    (cache->prev_ ? cache->prev_->next_ : caches_) = cache->next_;
+    if (cache->next_)
+    {
+        cache->next_->prev_ = cache->prev_;
+    }
+}
+
+// Approximate while other threads allocate or free; exact otherwise.
+inline std::size_t Central::blocks_in_use()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t free = free_count_;
+    for (auto cache = caches_; cache; cache = cache->next_)
+    {
+        free += cache->count();
+    }
+    return chunks_ * blocks_per_chunk_ - free;
+}
+
+} // namespace detail
+
+struct Stats
+{
+    std::size_t blocks_in_use = 0;
+    std::size_t bytes_in_use = 0;
+    std::size_t bytes_reserved = 0;
+};
+
+inline Stats stats()
+{
+    Stats s;
+    auto& r = detail::registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto pool = r.pools; pool; pool = pool->next_pool)
+    {
+        auto blocks = pool->blocks_in_use();
+        s.blocks_in_use += blocks;
+        s.bytes_in_use += blocks * pool->block_size();
+        s.bytes_reserved += pool->bytes_reserved();
+    }
+    return s;
+}
+
+// The pool of blocks of BlockSize bytes.
+template<std::size_t BlockSize>
+class FixedPool
+{
+public:
+    static_assert(BlockSize % granularity == 0, "use block_size_for to choose the size");
+
+    static void* allocate()
+    {
+        if (auto c = cache())
+        {
+            return c->allocate();
+        }
+        return central().take(1);
+    }
+
+    static void deallocate(void* p) noexcept
+    {
+        if (auto c = cache())
+        {
+            c->deallocate(p);
+            return;
+        }
+        auto block = static_cast<detail::Block*>(p);
+        central().give(block, block, 1);
+    }
+
+    static std::size_t blocks_in_use() { return central().blocks_in_use(); }
+    static std::size_t bytes_reserved() { return central().bytes_reserved(); }
+
+private:
+    static detail::Central& central()
+    {
+        // Never destroyed; see above. Made in place rather than with new so
+        // that only the chunks show up in the output of common.ipp.
+        alignas(detail::Central) static unsigned char storage[sizeof(detail::Central)];
+        static auto c = new (storage) detail::Central(BlockSize);
+        return *c;
+    }
+
+    // Null once the thread's cache has been destroyed, for blocks freed
+    // later while the thread exits, such as by thread_local objects made
+    // before it. Those go straight to the central list.
+    static detail::ThreadCache* cache()
+    {
+        thread_local bool finished = false;
+        if (finished)
+        {
+            return nullptr;
+        }
+        thread_local detail::ThreadCache c(central(), finished);
+        return &c;
+    }
+};
+
+template<class T>
+struct PoolAllocator
+{
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    static constexpr std::size_t block_size = block_size_for(sizeof(T));
+    static constexpr bool pooled = alignof(T) <= granularity;
+    using Pool = FixedPool<block_size>;
+
+    PoolAllocator() = default;
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        if (n == 1 && pooled)
+        {
+            return static_cast<T*>(Pool::allocate());
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n == 1 && pooled)
+        {
+            Pool::deallocate(p);
+        }
+        else
+        {
+            std::allocator<T>().deallocate(p, n);
+        }
+    }
+
+    template<class U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+    template<class U>
+    bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+};
+
+// Memory handed out in order from chunks got from operator new. Belongs to
+// one thread.
+class Arena
+{
+public:
+    static constexpr std::size_t default_chunk = std::size_t{64} << 10;
+
+    explicit Arena(std::size_t chunk = default_chunk)
+    : chunk_(chunk)
+    {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() { release(); }
+
+    void* allocate(std::size_t size, std::size_t align)
+    {
+        auto p = reinterpret_cast<std::uintptr_t>(next_);
+        p = (p + align - 1) / align * align;
+        if (!next_ || p + size > reinterpret_cast<std::uintptr_t>(end_))
+        {
+            // Anything too big for most of a chunk gets a chunk of its own,
+            // so the rest of the current one isn't wasted.
+            std::size_t wanted = sizeof(Chunk) + size + align;
+            if (wanted > chunk_ / 4)
+            {
+                used_ += size;
+                return align_in(add_chunk(wanted), align);
+            }
+            next_ = add_chunk(chunk_);
+            end_ = reinterpret_cast<char*>(chunks_) + chunk_;
+            p = reinterpret_cast<std::uintptr_t>(align_in(next_, align));
+        }
+        next_ = reinterpret_cast<char*>(p + size);
+        used_ += size;
+        return reinterpret_cast<void*>(p);
+    }
+
+    // Free everything allocated from the arena.
+    void release() noexcept
+    {
+        while (chunks_)
+        {
+            ::operator delete(std::exchange(chunks_, chunks_->next));
+        }
+        next_ = end_ = nullptr;
+        used_ = reserved_ = 0;
+    }
+
+    std::size_t bytes_used() const { return used_; }
+    std::size_t bytes_reserved() const { return reserved_; }
+
+private:
+    struct alignas(granularity) Chunk
+    {
+        Chunk* next;
+    };
+
+    // Add a chunk to the list, and return where its memory starts.
+    char* add_chunk(std::size_t size)
+    {
+        auto chunk = static_cast<Chunk*>(::operator new(size));
+        chunk->next = chunks_;
+        chunks_ = chunk;
+        reserved_ += size;
+        return reinterpret_cast<char*>(chunk + 1);
+    }
+
+    static char* align_in(char* p, std::size_t align)
+    {
+        auto i = reinterpret_cast<std::uintptr_t>(p);
+        return reinterpret_cast<char*>((i + align - 1) / align * align);
+    }
+
+    std::size_t chunk_;
+    Chunk* chunks_ = nullptr;
+    char* next_ = nullptr;
+    char* end_ = nullptr;
+    std::size_t used_ = 0;
+    std::size_t reserved_ = 0;
+};
+
+template<class T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& a) noexcept
+    : arena(&a)
+    {
+    }
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+    : arena(other.arena)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (n > std::size_t(-1) / sizeof(T))
+        {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) noexcept {}
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+    template<class U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+    Arena* arena;
+};
+
+} // namespace pool
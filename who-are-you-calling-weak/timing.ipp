@@ -0,0 +1,35 @@
+#include <chrono>
+#include <cstddef>
+
+// Simple timing helpers for the benchmark programs in this directory.
+
+// Stop the compiler discarding a value it thinks is unused.
+template<class T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Run f repeatedly until at least min_ms milliseconds have passed, doubling
+// the number of calls each time, and return the average time per call in
+// nanoseconds.
+template<class F>
+double time_per_call_ns(F f, double min_ms = 200.0)
+{
+    using clock = std::chrono::steady_clock;
+    std::size_t calls = 1;
+    for (;;)
+    {
+        auto begin = clock::now();
+        for (std::size_t i = 0; i < calls; ++i)
+        {
+            f();
+        }
+        std::chrono::duration<double, std::nano> elapsed = clock::now() - begin;
+        if (elapsed.count() >= min_ms * 1e6)
+        {
+            return elapsed.count() / calls;
+        }
+        calls *= 2;
+    }
+}
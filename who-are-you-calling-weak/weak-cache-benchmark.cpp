@@ -0,0 +1,170 @@
+#include "alloc-profiler.ipp"
+#include "weak-cache.ipp"
+#include "timing.ipp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// The memory used over time by caches of objects of 1KB, looked up by key,
+// while the program keeps only the last few hundred it asked for alive:
+//
+//   naive           - an unordered_map<int, weak_ptr<Payload>> of objects
+//                     made with make_shared, which only replaces an entry
+//                     when its key is asked for again
+//   sweep only      - a WeakCache that always uses make_shared, so only the
+//                     sweeping helps
+//   separate only   - a WeakCache that never sweeps, so only making the
+//                     objects apart from their control blocks helps
+//   WeakCache       - both
+//
+// Half the requests are for 1,000 popular keys and half for 100,000 others,
+// so most objects are asked for once or twice and then dropped. The memory
+// is what alloc-profiler.ipp counts as live. All four keep their entries in
+// an unordered_map, so the time per get compares the approaches rather than
+// the containers.
+
+struct Payload
+{
+    explicit Payload(int k)
+    : key(k)
+    {
+    }
+
+    int key;
+    char data[1020];
+};
+
+class NaiveCache
+{
+public:
+    std::shared_ptr<Payload> get(int key, int arg)
+    {
+        auto& w = entries_[key];
+        if (auto p = w.lock())
+        {
+            return p;
+        }
+        auto p = std::make_shared<Payload>(arg);
+        w = p;
+        return p;
+    }
+
+    weakcache::Stats stats() const
+    {
+        weakcache::Stats s;
+        s.entries = entries_.size();
+        for (const auto& e: entries_)
+        {
+            if (e.second.expired())
+            {
+                ++s.dead;
+                s.dead_bytes += weakcache::detail::inplace_overhead + sizeof(Payload);
+            }
+        }
+        s.live = s.entries - s.dead;
+        return s;
+    }
+
+private:
+    std::unordered_map<int, std::weak_ptr<Payload>> entries_;
+};
+
+using Cache = weakcache::WeakCache<int, Payload>;
+
+constexpr std::size_t steps = 400'000;
+constexpr std::size_t report_every = 50'000;
+constexpr std::size_t kept = 256;
+
+struct Result
+{
+    std::vector<double> mb;    // live at each report
+    double ns_per_get = 0;
+    weakcache::Stats stats;
+};
+
+template<class C>
+Result run(C& cache)
+{
+    Result r;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> popular(0, 999);
+    std::uniform_int_distribution<int> other(1'000, 100'999);
+    std::vector<std::shared_ptr<Payload>> in_use(kept);
+    auto before = allocprof::thread_counters().live_bytes();
+    std::chrono::duration<double, std::nano> elapsed{0};
+    for (std::size_t i = 1; i <= steps; ++i)
+    {
+        int key = random() % 2 ? popular(random) : other(random);
+        auto begin = std::chrono::steady_clock::now();
+        auto p = cache.get(key, key);
+        elapsed += std::chrono::steady_clock::now() - begin;
+        do_not_optimize(p->key);
+        in_use[i % kept] = std::move(p);
+        if (i % report_every == 0)
+        {
+            r.mb.push_back(static_cast<double>(allocprof::thread_counters().live_bytes() - before) / 1e6);
+        }
+    }
+    r.ns_per_get = elapsed.count() / steps;
+    r.stats = cache.stats();
+    return r;
+}
+
+int main()
+{
+    allocprof::report_at_exit(false);
+
+    std::vector<std::pair<const char*, Result>> results;
+    {
+        NaiveCache naive;
+        results.emplace_back("naive", run(naive));
+    }
+    {
+        weakcache::Options o;
+        o.separate_above = sizeof(Payload) + 1;
+        Cache cache(o);
+        results.emplace_back("sweep only", run(cache));
+    }
+    {
+        weakcache::Options o;
+        o.sweep_interval = std::size_t(-1);
+        Cache cache(o);
+        results.emplace_back("separate only", run(cache));
+    }
+    {
+        Cache cache;
+        results.emplace_back("WeakCache", run(cache));
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "MB in use after each " << report_every << " requests:\n";
+    std::cout << std::setw(10) << "requests";
+    for (const auto& r: results)
+    {
+        std::cout << std::setw(15) << r.first;
+    }
+    std::cout << "\n";
+    for (std::size_t row = 0; row < steps / report_every; ++row)
+    {
+        std::cout << std::setw(10) << (row + 1) * report_every;
+        for (const auto& r: results)
+        {
+            std::cout << std::setw(15) << r.second.mb[row];
+        }
+        std::cout << "\n";
+    }
+
+    std::cout << "\nAt the end:\n";
+    std::cout << std::setw(15) << "" << std::setw(10) << "ns/get" << std::setw(10) << "entries" << std::setw(10)
+              << "dead" << std::setw(15) << "dead MB" << "\n";
+    for (const auto& r: results)
+    {
+        const auto& s = r.second.stats;
+        std::cout << std::setw(15) << r.first << std::setw(10) << r.second.ns_per_get << std::setw(10) << s.entries
+                  << std::setw(10) << s.dead << std::setw(15) << static_cast<double>(s.dead_bytes) / 1e6 << "\n";
+    }
+}
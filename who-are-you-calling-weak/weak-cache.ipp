@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A cache from keys to objects that the cache doesn't keep alive, for when
+// a map<Key, weak_ptr<T>> would hold on to memory.
+//
+// As weak-ptr-make_shared.cpp shows, a weak_ptr to an object made with
+// make_shared keeps the object's memory until the weak_ptr goes, though the
+// object is destroyed long before. A map of weak_ptrs that are never removed
+// keeps the memory of every object that has ever been in it. WeakCache does
+// two things about that:
+//
+//  - get() makes objects of separate_above bytes or more with new, so they
+//    get a control block of their own, as in weak-ptr-from-ptr.cpp. A stale
+//    entry for one then only holds the control block. Smaller objects are
+//    made with make_shared, as the extra allocation would cost more than
+//    the memory it saves.
+//  - entries whose objects have been destroyed are removed in batches: every
+//    sweep_interval objects made, the cache looks through sweep_batch of the
+//    hash table's buckets, carrying on where it stopped last time, so each
+//    entry is looked at now and then without any call taking long.
+//
+// stats() counts the entries whose objects have gone, and the memory they
+// still hold: the object's too if it was made with make_shared. The sizes
+// are those of libstdc++'s control blocks.
+//
+//     weakcache::WeakCache<std::string, Texture> textures;
+//     std::shared_ptr<Texture> t = textures.get(name, name);
+//
+// Like the containers it uses, a WeakCache must not be used by more than one
+// thread at a time. The objects it gives out can go anywhere.
+
+namespace weakcache
+{
+
+namespace detail
+{
+
+// The control block make_shared allocates with the object: a vtable and the
+// two counts, as in libstdc++.
+constexpr std::size_t inplace_overhead = sizeof(void*) + 2 * sizeof(int);
+
+// The control block of a shared_ptr made from a pointer, which also holds
+// the pointer.
+constexpr std::size_t pointer_block_size = inplace_overhead + sizeof(void*);
+
+} // namespace detail
+
+struct Options
+{
+    std::size_t separate_above = 256;
+    std::size_t sweep_interval = 64;
+    std::size_t sweep_batch = 128;
+};
+
+struct Stats
+{
+    std::size_t entries = 0;
+    std::size_t live = 0;
+    std::size_t dead = 0;
+    std::size_t dead_bytes = 0;    // held by the dead entries
+};
+
+template<class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+class WeakCache
+{
+public:
+    // Whether get() makes its objects apart from their control blocks.
+    static constexpr bool separate(const Options& o) { return sizeof(T) >= o.separate_above; }
+
+    explicit WeakCache(Options options = Options())
+    : options_(options),
+      until_sweep_(options.sweep_interval)
+    {
+    }
+
+    // The object for key if there is one still alive, or else a new one,
+    // made from args.
+    template<class... Args>
+    std::shared_ptr<T> get(const Key& key, Args&&... args)
+    {
+        auto& entry = entries_[key];
+        if (auto p = entry.object.lock())
+        {
+            return p;
+        }
+        std::shared_ptr<T> p;
+        if (separate(options_))
+        {
+            p.reset(new T(std::forward<Args>(args)...));
+            entry.held = detail::pointer_block_size;
+        }
+        else
+        {
+            p = std::make_shared<T>(std::forward<Args>(args)...);
+            entry.held = detail::inplace_overhead + sizeof(T);
+        }
+        entry.object = p;
+        if (--until_sweep_ == 0)
+        {
+            until_sweep_ = options_.sweep_interval;
+            sweep(options_.sweep_batch);
+        }
+        return p;
+    }
+
+    // The object for key, or null if there isn't one alive.
+    std::shared_ptr<T> find(const Key& key) const
+    {
+        auto i = entries_.find(key);
+        return i == entries_.end() ? nullptr : i->second.object.lock();
+    }
+
+    void erase(const Key& key) { entries_.erase(key); }
+
+    // Remove the dead entries in the next buckets buckets of the table, and
+    // return how many there were.
+    std::size_t sweep(std::size_t buckets)
+    {
+        std::size_t count = entries_.bucket_count();
+        buckets = std::min(buckets, count);
+        for (std::size_t i = 0; i < buckets; ++i)
+        {
+            std::size_t b = (cursor_ + i) % count;
+            for (auto e = entries_.begin(b); e != entries_.end(b); ++e)
+            {
+                if (e->second.object.expired())
+                {
+                    dead_keys_.push_back(e->first);
+                }
+            }
+        }
+        cursor_ = (cursor_ + buckets) % count;
+        std::size_t removed = dead_keys_.size();
+        for (const auto& key: dead_keys_)
+        {
+            entries_.erase(key);
+        }
+        dead_keys_.clear();
+        return removed;
+    }
+
+    std::size_t sweep_all() { return sweep(entries_.bucket_count()); }
+
+    // Looks at every entry.
+    Stats stats() const
+    {
+        Stats s;
+        s.entries = entries_.size();
+        for (const auto& e: entries_)
+        {
+            if (e.second.object.expired())
+            {
+                ++s.dead;
+                s.dead_bytes += e.second.held;
+            }
+        }
+        s.live = s.entries - s.dead;
+        return s;
+    }
+
+    std::size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<T> object;
+        std::size_t held = 0;    // bytes held by object once T has gone
+    };
+
+    std::unordered_map<Key, Entry, Hash, KeyEqual> entries_;
+    Options options_;
+    std::size_t until_sweep_;
+    std::size_t cursor_ = 0;
+    std::vector<Key> dead_keys_;    // kept to reuse its memory
+};
+
+} // namespace weakcache